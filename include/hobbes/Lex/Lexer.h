@@ -2,12 +2,16 @@
 
 #include "hobbes/Lex/Token.h"
 
-#include <iostream>
 #include <llvm/ADT/StringRef.h>
-#include <llvm/Support/MemoryBuffer.h>
 
 namespace hobbes {
 
+/// A hand-written lexer for hobbes source text.
+///
+/// Lexers hold no state outside of themselves (so any number may run at once)
+/// and are cheap to copy, so a copy can be used to look ahead.  Tokens are
+/// split exactly as the flex scanner (read/pgen/hexpr.l) splits them, with
+/// the same line:column positions.
 class Lexer {
 
 public:
@@ -16,34 +20,45 @@ public:
   }
   auto InitLexer(const char *BufStart, const char *BufPtr, const char *BufEnd)
       -> void;
-  auto LexIdentifier(Token &Result, const char *CurPtr) -> bool;
-  auto LexNumericConstant(Token &Result, const char *CurPtr) -> bool;
-  auto SkipSingleLineComment(const char *CurPtr) -> bool;
-  auto SkipMultiLineComment(const char *CurPtr) -> bool;
-  auto LexStringLiteral(Token &Result, const char *CurPtr) -> bool;
-  auto LexCharConstant(Token &Result, const char *CurPtr, tok::TokenKind Kind)
-      -> bool;
-  auto LexEndOfFile(Token &Result, const char *CurPtr) -> bool;
 
-  /// Return the next token in the file. If the Lexer is at the end of the
-  /// file it will return tok::eof.
+  /// Read the next token from the buffer.  At the end of the buffer this
+  /// produces tok::eof and returns false.
   auto LexToken(Token &Result) -> bool;
 
-  auto FormTokenWithChars(Token &Result, const char *TokEnd,
-                          tok::TokenKind Kind) -> void {
-    unsigned TokLen = TokEnd - BufferPtr;
-    Result.setLength(TokLen);
-    Result.setKind(Kind);
-    Result.setLiteralData(llvm::StringRef(BufferPtr, TokLen));
-    BufferPtr = TokEnd;
-  }
-  
   llvm::StringRef getBuffer() const {
     return llvm::StringRef(BufferStart, BufferEnd - BufferStart);
   }
+
 private:
+  auto LexIdentifier(Token &Result, const char *CurPtr) -> bool;
+  auto LexNumericConstant(Token &Result, const char *CurPtr) -> bool;
+  auto LexPeriod(Token &Result, const char *CurPtr) -> bool;
+  auto LexStringLiteral(Token &Result, const char *CurPtr) -> bool;
+  auto LexCharConstant(Token &Result, const char *CurPtr) -> bool;
+  auto LexEndOfFile(Token &Result, const char *CurPtr) -> bool;
+  auto SkipSingleLineComment(const char *CurPtr) -> void;
+  auto SkipMultiLineComment(const char *CurPtr) -> void;
+
+  /// The end of a quoted sequence (where quotes can be escaped with '\'), or
+  /// nullptr if no such sequence starts at CurPtr
+  auto ScanQuoted(const char *CurPtr, char Q, bool AllowEmpty) const
+      -> const char *;
+
+  auto peekChar(const char *Ptr, unsigned N = 0) const -> char {
+    return (Ptr + N < BufferEnd) ? Ptr[N] : 0;
+  }
+
+  auto FormTokenWithChars(Token &Result, const char *TokEnd,
+                          tok::TokenKind Kind) -> void;
+
   const char *BufferStart; // start of the buffer
   const char *BufferEnd;   // end of the buffer
   const char *BufferPtr;   // current position in the buffer
+  unsigned Line;           // line of the current position (from 1)
+  unsigned Column;         // column of the current position (from 1)
+  bool AtIndent;           // whether an indented line starts at the current position
+  unsigned LastLine;       // location of the last token read
+  unsigned LastColumn;
+  unsigned LastEndColumn;
 };
 }
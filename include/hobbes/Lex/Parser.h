@@ -5,53 +5,144 @@
 #include "hobbes/lang/module.H"
 #include "hobbes/lang/expr.H"
 #include "hobbes/lang/pat/pattern.H"
+#include "hobbes/read/parser.H"
 
-#include <llvm/Support/MemoryBuffer.h>
-#include <llvm/ADT/Twine.h>
-#include <llvm/ADT/StringMap.h>
-#include <llvm/Support/SourceMgr.h>
-
+#include <deque>
 #include <memory>
+#include <string>
 
 namespace hobbes {
 
+class cc;
+
+/// A recursive-descent parser for hobbes modules, definitions, expressions
+/// and types.
+///
+/// This accepts the same language as the bison grammar (read/pgen/hexpr.y)
+/// and builds the same terms, but all parse state is held here (so any number
+/// of parsers can run at once, or nest as modules are imported).
 class Parser {
   enum class Assoc {
       right,
-      left,   
-  };  
-  llvm::StringMap<std::pair<int, Assoc>> operators;
-  llvm::StringMap<std::pair<int, Assoc>> type_operators;
-  
+      left,
+  };
+
 public:
-  Parser(Lexer& lexer);  
-  Lexer Lex;
-  
+  Parser(cc *C, Lexer &Lex, const std::string &ModulePath = "");
+
   /// Current Token we are looking at
   Token Tok;
-  bool ParseModule();
-  bool ParseModuleDefs();
-  bool ParseClassDef();
+
+  // entry points
+  ModulePtr ParseModule();
+  ExprDefn ParseExprDefn();
+  ExprPtr ParseExpr();
+
+  // module definitions
+  ModuleDefPtr ParseModuleDef();
   std::shared_ptr<MImport> ParseImportStatement();
-  MonoTypePtr ParseType();
-  ConstraintPtr ParseTypePredicate();
-  bool ParseQualifiedId(llvm::Twine& QualID);  
-  void ConsumeToken();
-  void ExpectTokenKind(tok::TokenKind kind);
+  ModuleDefPtr ParseTypeDef();
+  std::shared_ptr<MVarTypeDef> ParseVarTypeBinding();
+  std::shared_ptr<MVarDef> ParseVarDef();
+  ModuleDefPtr ParseClassDef();
+  ModuleDefPtr ParseInstanceDef();
+  str::seq ParseNames();
+  str::seq ParseNameSeq();
+  std::string ParseName();
+  std::string ParseQualifiedId();
 
-  std::pair<int, Assoc> GetBinopPrecedence(Token& tok);  
-  ExprPtr ParseBinopRHS(ExprPtr LHS, int MinPrec);
-  ExprPtr ParsePrimaryExpression();
-  ExprPtr ParseIfExpr();
-  ExprPtr ParseIdentifierExpr();
+  // expressions
   ExprPtr ParseExpression();
-  ExprPtr ParseMatchExpr();
+  ExprPtr ParseL0Operand();
+  ExprPtr ParseL1Expression();
+  ExprPtr ParseL2Expression();
+  ExprPtr ParseUnaryExpr();
+  ExprPtr ParseBinopRHS(ExprPtr LHS, int MinPrec, const Pos &Begin);
+  ExprPtr ParseL4Expression();
+  ExprPtr ParseIfExpr();
   ExprPtr ParseLetExpr();
+  ExprPtr ParseMatchExpr();
+  ExprPtr ParseParserExpr();
+  ExprPtr ParseDoExpr();
+  ExprPtr ParseL5Expression();
+  ExprPtr ParsePostfixExpression(bool AllowFieldPath = true);
+  ExprPtr ParsePrimaryExpression();
+  ExprPtr ParseLambdaExpr();
+  ExprPtr ParseArrayExpr();
+  ExprPtr ParseVariantExpr();
+  ExprPtr ParseCaseExpr();
+  ExprPtr ParseRecordExpr();
+  ExprPtr ParseParenExpr();
   ExprPtr ParseNumericConstant();
+  Exprs ParseCallArgs(tok::TokenKind ClosingTok);
+  str::seq ParseFieldPath();
+  std::string ParseRecordFieldName();
 
-  std::vector<PatternPtr> ParsePatternSequence(tok::TokenKind ClosingTok);
-  std::vector<MatchRecord::Field>* ParseRecordPatternFields(tok::TokenKind ClosingTok);  
+  // patterns
+  PatternRows ParsePatternRows();
+  Patterns ParsePatterns();
+  Patterns ParsePatternSequence(tok::TokenKind ClosingTok);
+  MatchRecord::Fields ParseRecordPatternFields(tok::TokenKind ClosingTok);
   PatternPtr ParsePattern();
   PatternPtr ParseIrrefutablePattern();
+
+  // types
+  QualTypePtr ParseQualType();
+  Constraints ParseConstraints();
+  ConstraintPtr ParseTypePredicate();
+  MonoTypePtr ParseType();
+  MonoTypePtr ParseL1Type(MonoTypes *ArgList = nullptr);
+  MonoTypePtr ParseTypeFrom(const MonoTypePtr &First, const MonoTypes &ArgList);
+  MonoTypePtr ParseTypeSuffix(MonoTypePtr T);
+  MonoTypePtr ParseParenTypeRest(const MonoTypePtr &First, const Pos &Begin);
+  Record::Members ParseRecordTypeRest(Record::Members Ms);
+  Variant::Members ParseVariantTypeRest(Variant::Members Ms);
+
+  void ConsumeToken();
+  void ExpectTokenKind(tok::TokenKind Kind);
+
+private:
+  cc *C;
+  Lexer &Lex;
+  std::string ModulePath;
+
+  // tokens lexed past the current one (to look ahead)
+  std::deque<Token> Ahead;
+
+  // the end of the last token consumed (the end of the last term parsed)
+  Pos PrevEnd;
+
+  // a 'class' or 'instance' definition is being read, so indented lines
+  // start new members (a simple version of the "off side" rule)
+  int WantIndent;
+
+  auto Peek(unsigned N) -> const Token &;
+  auto PeekKind(unsigned N) -> tok::TokenKind;
+  bool IsFollowedAfterParens(tok::TokenKind Kind);
+  bool IsOpName(tok::TokenKind Kind) const;
+  bool IsRecordFieldName(tok::TokenKind Kind) const;
+  bool StartsPrimaryExpression(tok::TokenKind Kind) const;
+  bool StartsPattern(tok::TokenKind Kind) const;
+  bool StartsType(tok::TokenKind Kind) const;
+  std::pair<int, Assoc> GetBinopPrecedence(const Token &T) const;
+
+  Pos TokBegin() const { return Pos(Tok.getLine(), Tok.getColumn()); }
+  Pos TokEnd() const { return Pos(Tok.getLine(), Tok.getEndColumn()); }
+  LexicalAnnotation TokAnnotation() const;
+
+  std::string ConsumeIdentifier();
+  std::string ConsumeOpName();
+  [[noreturn]] void Unexpected(const std::string &Expecting);
+
+public:
+  /// The source range of the current token (to report errors raised outside of the parser)
+  LexicalAnnotation CurrentAnnotation() const { return TokAnnotation(); }
 };
+
+// read modules, definitions and expressions with the recursive-descent parser
+// (these are the defaults for cc::readModuleFile, readModule, readExprDefn and readExpr)
+ModulePtr parseModuleFile(cc*, const std::string&);
+ModulePtr parseModule(cc*, const std::string&);
+ExprDefn parseExprDefn(cc*, const std::string&);
+ExprPtr parseExpr(cc*, const std::string&);
 }
@@ -11,33 +11,55 @@ enum TokenKind : short {
   NUM_TOKENS,
 };
 std::string getTokenName(TokenKind t);
+
+/// The source spelling of punctuators and keywords (or nullptr for other tokens)
+const char *getTokenSpelling(TokenKind t);
 }
 
+/// A token refers directly into the lexed buffer (its text is never copied)
+/// and carries the line:column range that flex would have given it.
 class Token {
-  tok::TokenKind Kind;
-  unsigned UIntData;
-  void *PtrData;
+  tok::TokenKind Kind = tok::unknown;
   llvm::StringRef LiteralData;
+  unsigned Line = 0;
+  unsigned Column = 0;
+  unsigned EndColumn = 0;
+  bool AtIndent = false;
 
 public:
-  auto getKind() -> tok::TokenKind { return Kind; }
+  auto getKind() const -> tok::TokenKind { return Kind; }
   auto setKind(tok::TokenKind K) -> void { Kind = K; }
-  auto setLength(unsigned Len) -> void { UIntData = Len; };
-  //  auto setLocation(SourceLocation L) -> void { Loc = L.getRawEncoding(); }
   auto startToken() -> void {
     Kind = tok::unknown;
-    PtrData = nullptr;
-    UIntData = 0;
+    LiteralData = llvm::StringRef();
+    Line = Column = EndColumn = 0;
+    AtIndent = false;
   }
   auto setLiteralData(llvm::StringRef Data) -> void { LiteralData = Data; }
-  auto getLiteralData() -> llvm::StringRef { return LiteralData; }
-  auto is(tok::TokenKind K) -> bool { return Kind == K; }
-  auto isNot(tok::TokenKind K) -> bool { return Kind != K; }
-  auto isOneOf(tok::TokenKind K1, tok::TokenKind K2) -> bool {
+  auto getLiteralData() const -> llvm::StringRef { return LiteralData; }
+  auto getLength() const -> unsigned { return LiteralData.size(); }
+
+  auto setLocation(unsigned L, unsigned C, unsigned EC) -> void {
+    Line = L;
+    Column = C;
+    EndColumn = EC;
+  }
+  auto getLine() const -> unsigned { return Line; }
+  auto getColumn() const -> unsigned { return Column; }
+  auto getEndColumn() const -> unsigned { return EndColumn; }
+
+  /// Whether this token follows a newline and space or tab
+  /// (which marks the next member in class and instance definitions)
+  auto setAtIndent(bool F) -> void { AtIndent = F; }
+  auto isAtIndent() const -> bool { return AtIndent; }
+
+  auto is(tok::TokenKind K) const -> bool { return Kind == K; }
+  auto isNot(tok::TokenKind K) const -> bool { return Kind != K; }
+  auto isOneOf(tok::TokenKind K1, tok::TokenKind K2) const -> bool {
     return is(K1) || is(K2);
   }
   template <typename... Ts>
-  auto isOneOf(tok::TokenKind K1, tok::TokenKind K2, Ts... Ks) -> bool {
+  auto isOneOf(tok::TokenKind K1, tok::TokenKind K2, Ts... Ks) const -> bool {
     return is(K1) || isOneOf(K2, Ks...);
   }
 };
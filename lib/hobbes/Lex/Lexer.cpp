@@ -2,10 +2,9 @@
 
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringSwitch.h>
-#include <llvm/ADT/Twine.h>
-#include <llvm/Support/ErrorOr.h>
-#include <llvm/Support/MemoryBuffer.h>
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 namespace hobbes {
@@ -14,22 +13,57 @@ auto Lexer::InitLexer(const char *BufStart, const char *BufPtr,
   BufferStart = BufStart;
   BufferPtr = BufPtr;
   BufferEnd = BufEnd;
+  Line = 1;
+  Column = 1;
+  AtIndent = false;
+  LastLine = 1;
+  LastColumn = 1;
+  LastEndColumn = 1;
 }
 
-auto isIdentifierBody(const char C) -> bool {
+static auto isIdentifierHead(const char C) -> bool {
   return (('A' <= C) && (C <= 'Z')) || (('a' <= C) && (C <= 'z')) ||
-         (('0' <= C) && (C <= '9'));
+         (C == '_');
 }
 
-auto isNumberBody(const char C) -> bool { return (('0' <= C) && (C <= '9')); }
+static auto isIdentifierBody(const char C) -> bool {
+  return isIdentifierHead(C) || (('0' <= C) && (C <= '9'));
+}
+
+static auto isNumberBody(const char C) -> bool {
+  return (('0' <= C) && (C <= '9'));
+}
+
+static auto isHexDigit(const char C) -> bool {
+  return isNumberBody(C) || (('a' <= C) && (C <= 'f')) ||
+         (('A' <= C) && (C <= 'F'));
+}
+
+auto Lexer::FormTokenWithChars(Token &Result, const char *TokEnd,
+                               tok::TokenKind Kind) -> void {
+  unsigned TokLen = TokEnd - BufferPtr;
+
+  // as with flex, a token is placed on the line where it ends
+  Line += std::count(BufferPtr, TokEnd, '\n');
+
+  Result.setKind(Kind);
+  Result.setLiteralData(llvm::StringRef(BufferPtr, TokLen));
+  Result.setLocation(Line, Column, Column + TokLen - 1);
+  Result.setAtIndent(AtIndent);
+
+  LastLine = Line;
+  LastColumn = Column;
+  LastEndColumn = Column + TokLen - 1;
+  Column += TokLen;
+  AtIndent = false;
+  BufferPtr = TokEnd;
+}
 
 auto Lexer::LexIdentifier(Token &Result, const char *CurPtr) -> bool {
-  // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z$]
-  unsigned char C = *CurPtr++;
-  while (isIdentifierBody(C)) {
-    C = *CurPtr++;
+  // Match [_A-Za-z0-9]*, we have already matched [_A-Za-z]
+  while (CurPtr < BufferEnd && isIdentifierBody(*CurPtr)) {
+    ++CurPtr;
   }
-  --CurPtr; // Back up over the skipped character.
   auto Kind = llvm::StringSwitch<tok::TokenKind>(
                   llvm::StringRef(BufferPtr, CurPtr - BufferPtr))
                   .Case("module", tok::kw_module)
@@ -66,101 +100,300 @@ auto Lexer::LexIdentifier(Token &Result, const char *CurPtr) -> bool {
   return true;
 }
 
+/// Numeric constants, bytes, timespans, times and datetimes all start with a
+/// digit.  The longest of these forms is taken (with ties going to the form
+/// listed first), just as in the flex scanner.
 auto Lexer::LexNumericConstant(Token &Result, const char *CurPtr) -> bool {
-  char C = *CurPtr++;
-  char PrevCh = 0;
-  while (isNumberBody(C)) {
-    PrevCh = C;
-    C = *CurPtr++;
+  const char *Start = CurPtr;
+  auto digitsAt = [&](const char *P, unsigned N) {
+    for (unsigned I = 0; I < N; ++I) {
+      if (!isNumberBody(peekChar(P, I))) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // 0Xff (a single byte) or 0xdeadbeef (a byte array)
+  if (peekChar(Start) == '0' && (peekChar(Start, 1) == 'X' || peekChar(Start, 1) == 'x')) {
+    const char *P = Start + 2;
+    if (peekChar(Start, 1) == 'X') {
+      if (isHexDigit(peekChar(P)) && isHexDigit(peekChar(P, 1))) {
+        FormTokenWithChars(Result, P + 2, tok::byte_constant);
+        return true;
+      }
+    } else {
+      while (isHexDigit(peekChar(P)) && isHexDigit(peekChar(P, 1))) {
+        P += 2;
+      }
+      if (P > Start + 2) {
+        FormTokenWithChars(Result, P, tok::bytes_literal);
+        return true;
+      }
+    }
   }
-  // If we fell out, check for a sign, due to 1e+12.  If we have one, continue.
-  if ((C == '-' || C == '+') && (PrevCh == 'E' || PrevCh == 'e')) {
-    return LexNumericConstant(Result, CurPtr++);
+
+  const char *DigitsEnd = Start;
+  while (isNumberBody(peekChar(DigitsEnd))) {
+    ++DigitsEnd;
   }
-  // Back Up
-  CurPtr--;
-  // Update the location of token as well as BufferPtr.
-  const char *TokStart = BufferPtr;
-  FormTokenWithChars(Result, CurPtr, tok::numeric_constant);
-  Result.setLiteralData(TokStart);
-  return true;
-}
+  unsigned NDigits = DigitsEnd - Start;
 
-auto Lexer::LexStringLiteral(Token &Result, const char *CurPtr) -> bool {
-  // consume the '"' character
-  CurPtr++;
-  while (*CurPtr != '"') {
-    ++CurPtr;
-    if (*CurPtr == 0) {
-      LexEndOfFile(Result, CurPtr);
-      return true;
+  const char *End = DigitsEnd;
+  tok::TokenKind Kind = tok::numeric_constant;
+  auto candidate = [&](const char *E, tok::TokenKind K) {
+    if (E > End) {
+      End = E;
+      Kind = K;
+    }
+  };
+
+  // 4.2 4.2f 42.0%
+  if (peekChar(DigitsEnd) == '.' && isNumberBody(peekChar(DigitsEnd, 1))) {
+    const char *P = DigitsEnd + 1;
+    while (isNumberBody(peekChar(P))) {
+      ++P;
+    }
+    if (peekChar(P) == 'f' || peekChar(P) == 'F') {
+      candidate(P + 1, tok::float_constant);
+    } else if (peekChar(P) == '%') {
+      candidate(P + 1, tok::double_constant);
+    } else {
+      candidate(P, tok::double_constant);
     }
   }
-  FormTokenWithChars(Result, CurPtr - 1, tok::string_literal);
-  BufferPtr = CurPtr + 1;
-  return false;
+
+  // 42L 42S
+  if (peekChar(DigitsEnd) == 'L' || peekChar(DigitsEnd) == 'l') {
+    candidate(DigitsEnd + 1, tok::long_constant);
+  } else if (peekChar(DigitsEnd) == 'S') {
+    candidate(DigitsEnd + 1, tok::short_constant);
+  }
+
+  // 10ms 10us 10s 10m 10h 10d 10min 10hour 10day
+  for (const char *Unit : {"ms", "us", "s", "m", "h", "d", "min", "hour", "day"}) {
+    size_t N = strlen(Unit);
+    if (size_t(BufferEnd - DigitsEnd) >= N && llvm::StringRef(DigitsEnd, N) == Unit) {
+      candidate(DigitsEnd + N, tok::timespan_literal);
+    }
+  }
+
+  // HH:MM[:SS[.sss|.ssssss]]
+  auto timeSuffix = [&](const char *P) -> const char * {
+    if (!(peekChar(P) == ':' && digitsAt(P + 1, 2))) {
+      return nullptr;
+    }
+    P += 3;
+    if (peekChar(P) == ':' && digitsAt(P + 1, 2)) {
+      P += 3;
+      if (peekChar(P) == '.' && digitsAt(P + 1, 6)) {
+        P += 7;
+      } else if (peekChar(P) == '.' && digitsAt(P + 1, 3)) {
+        P += 4;
+      }
+    }
+    return P;
+  };
+  if (NDigits == 2) {
+    if (const char *P = timeSuffix(DigitsEnd)) {
+      candidate(P, tok::time_literal);
+    }
+  }
+
+  // YYYY-MM-DD[THH:MM[:SS[.sss|.ssssss]]]
+  if (NDigits == 4 && peekChar(DigitsEnd) == '-' && digitsAt(DigitsEnd + 1, 2) &&
+      peekChar(DigitsEnd, 3) == '-' && digitsAt(DigitsEnd + 4, 2)) {
+    const char *P = DigitsEnd + 6;
+    if (peekChar(P) == 'T' && digitsAt(P + 1, 2)) {
+      if (const char *TP = timeSuffix(P + 3)) {
+        P = TP;
+      }
+    }
+    candidate(P, tok::datetime_literal);
+  }
+
+  FormTokenWithChars(Result, End, Kind);
+  return true;
 }
 
-auto Lexer::LexCharConstant(Token &Result, const char *CurPtr,
-                            tok::TokenKind Kind) -> bool {}
+/// '.', '..' or a tuple section like '.0.1'
+auto Lexer::LexPeriod(Token &Result, const char *CurPtr) -> bool {
+  if (peekChar(CurPtr, 1) == '.') {
+    FormTokenWithChars(Result, CurPtr + 2, tok::upto);
+    return true;
+  }
 
-auto Lexer::LexEndOfFile(Token &Result, const char *CurPtr) -> bool {
-  FormTokenWithChars(Result, CurPtr, tok::eof);
+  const char *P = CurPtr;
+  unsigned Parts = 0;
+  while (Parts < 2 && peekChar(P) == '.' && isNumberBody(peekChar(P, 1))) {
+    ++P;
+    while (isNumberBody(peekChar(P))) {
+      ++P;
+    }
+    ++Parts;
+  }
+  if (Parts == 2) {
+    FormTokenWithChars(Result, P, tok::tuple_section);
+  } else {
+    FormTokenWithChars(Result, CurPtr + 1, tok::period);
+  }
   return true;
 }
 
-auto Lexer::SkipMultiLineComment(const char *CurPtr) -> bool {
-  while (*CurPtr != 0) {
-    ++CurPtr;
-    if (*CurPtr == '*') {
-      ++CurPtr;
-      if (*CurPtr == '/') {
-        ++CurPtr;
+auto Lexer::ScanQuoted(const char *CurPtr, char Q, bool AllowEmpty) const
+    -> const char * {
+  // a quote ends the sequence unless it's escaped, but escaped quotes may end
+  // it too (as in "\"), so the longest possible sequence is taken
+  const char *End = nullptr;
+  for (const char *P = CurPtr + 1; P < BufferEnd; ++P) {
+    if (*P == Q) {
+      if (P == CurPtr + 1) {
+        if (AllowEmpty) {
+          End = P + 1;
+        }
+        break;
+      }
+      End = P + 1;
+      if (*(P - 1) != '\\') {
         break;
       }
     }
   }
-  BufferPtr = CurPtr;
+  return End;
+}
+
+auto Lexer::LexStringLiteral(Token &Result, const char *CurPtr) -> bool {
+  if (const char *End = ScanQuoted(CurPtr, '"', true)) {
+    FormTokenWithChars(Result, End, tok::string_literal);
+  } else {
+    FormTokenWithChars(Result, CurPtr + 1, tok::unknown);
+  }
+  return true;
+}
+
+/// A character constant, a regular expression or a single quote
+auto Lexer::LexCharConstant(Token &Result, const char *CurPtr) -> bool {
+  const char *End = CurPtr + 1;
+  tok::TokenKind Kind = tok::squote;
+
+  char C = peekChar(CurPtr, 1);
+  if (C != '\n' && C != 0 && peekChar(CurPtr, 2) == '\'') {
+    End = CurPtr + 3;
+    Kind = tok::char_constant;
+  }
+  if (C == '\\' && peekChar(CurPtr, 2) != '\n' && peekChar(CurPtr, 3) == '\'') {
+    End = CurPtr + 4;
+    Kind = tok::char_constant;
+  }
+  if (const char *RE = ScanQuoted(CurPtr, '\'', false)) {
+    if (RE > End) {
+      End = RE;
+      Kind = tok::regex_literal;
+    }
+  }
+  FormTokenWithChars(Result, End, Kind);
   return true;
 }
 
-auto Lexer::SkipSingleLineComment(const char *CurPtr) -> bool {
-  while (*CurPtr != 0 && *CurPtr != '\n') {
+auto Lexer::LexEndOfFile(Token &Result, const char *CurPtr) -> bool {
+  // as with flex, the end of the buffer is reported at the last token read
+  unsigned L = LastLine, C = LastColumn, EC = LastEndColumn;
+  FormTokenWithChars(Result, CurPtr, tok::eof);
+  Result.setLocation(L, C, EC);
+  LastLine = L;
+  LastColumn = C;
+  LastEndColumn = EC;
+  return false;
+}
+
+auto Lexer::SkipSingleLineComment(const char *CurPtr) -> void {
+  while (CurPtr < BufferEnd && *CurPtr != '\n') {
     ++CurPtr;
   }
-  if (*CurPtr == '\n') {
-    CurPtr++;
+  if (CurPtr < BufferEnd) {
+    ++CurPtr;
+    ++Line;
   }
+  Column = 1;
   BufferPtr = CurPtr;
-  return true;
 }
 
-/// Advance by one character and return the previous character
-char advanceChar(const char *Ptr) { return *Ptr++; }
+auto Lexer::SkipMultiLineComment(const char *CurPtr) -> void {
+  CurPtr += 2;
+  Column += 2;
+  while (CurPtr < BufferEnd) {
+    if (*CurPtr == '*' && peekChar(CurPtr, 1) == '/') {
+      CurPtr += 2;
+      Column += 2;
+      break;
+    } else if (*CurPtr == '\n') {
+      ++Line;
+      Column = 1;
+    } else {
+      ++Column;
+    }
+    ++CurPtr;
+  }
+  BufferPtr = CurPtr;
+}
 
 auto Lexer::LexToken(Token &Result) -> bool {
-  // return here if a comment was encountered
-  while (1) {
+  Result.startToken();
+
+  // return here after whitespace and comments
+  while (true) {
     const char *CurPtr = BufferPtr;
-    // skip whitespace
-    if ((*CurPtr == ' ') || (*CurPtr == '\t')) {
-      ++CurPtr;
-      while ((*CurPtr == ' ') || (*CurPtr == '\t')) {
-        ++CurPtr;
-      }
-      BufferPtr = CurPtr;
+    if (CurPtr >= BufferEnd) {
+      return LexEndOfFile(Result, CurPtr);
     }
 
-    // Read a character, advancing over it.
-    char Char = advanceChar(CurPtr);
+    char Char = *CurPtr;
     tok::TokenKind Kind;
+    unsigned Len = 1;
     switch (Char) {
-    case 0:
-      if (CurPtr - 1 == BufferEnd) {
-        return LexEndOfFile(Result, CurPtr - 1);
+    case '\n':
+      ++Line;
+      if (peekChar(CurPtr, 1) == ' ' || peekChar(CurPtr, 1) == '\t') {
+        BufferPtr += 2;
+        Column = 2;
+        AtIndent = true;
       } else {
-        Kind = tok::unknown;
+        BufferPtr += 1;
+        Column = 1;
+      }
+      continue;
+    case '\r':
+      if (peekChar(CurPtr, 1) == ' ' || peekChar(CurPtr, 1) == '\t') {
+        BufferPtr += 2;
+        Column += 2;
+        AtIndent = true;
+      } else {
+        BufferPtr += 1;
+        Column += 1;
+      }
+      continue;
+    case ' ':
+      if (peekChar(CurPtr, 1) == '.' && peekChar(CurPtr, 2) == ' ') {
+        FormTokenWithChars(Result, CurPtr + 3, tok::compose);
+        return true;
+      }
+      // fall through
+    case '\t':
+    case '\f':
+      BufferPtr += 1;
+      Column += 1;
+      continue;
+    case '/':
+      // (as in the flex scanner, a line comment has to end in a newline)
+      if (peekChar(CurPtr, 1) == '/' &&
+          std::memchr(CurPtr, '\n', BufferEnd - CurPtr) != nullptr) {
+        SkipSingleLineComment(CurPtr);
+        continue;
+      } else if (peekChar(CurPtr, 1) == '*') {
+        SkipMultiLineComment(CurPtr);
+        continue;
       }
+      Kind = tok::slash;
       break;
     // clang-format off
     case '0': case '1': case '2': case '3': case '4':
@@ -181,6 +414,10 @@ auto Lexer::LexToken(Token &Result) -> bool {
     // clang-format on
     case '"':
       return LexStringLiteral(Result, CurPtr);
+    case '\'':
+      return LexCharConstant(Result, CurPtr);
+    case '.':
+      return LexPeriod(Result, CurPtr);
     case '[':
       Kind = tok::l_square;
       break;
@@ -208,159 +445,107 @@ auto Lexer::LexToken(Token &Result) -> bool {
     case ';':
       Kind = tok::semi;
       break;
-    case '=': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '=') {
-        C = advanceChar(CurPtr);
-        if (C == '=') {
-          Kind = tok::equalequalequal;
-        } else {
-          CurPtr--;
-          Kind = tok::equalequal;
-        }
-      } else if (C == '>') {
-        Kind = tok::doublearrow;
-      } else {
-        CurPtr--;
-        Kind = tok::equal;
-      }
+    case '*':
+      Kind = tok::star;
       break;
-    }
-    case '+': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '+') {
+    case '%':
+      Kind = tok::percent;
+      break;
+    case '\\':
+      Kind = tok::fun;
+      break;
+    case '^':
+      Kind = tok::caret;
+      break;
+    case '@':
+      Kind = tok::at;
+      break;
+    case '$':
+      Kind = tok::dollar;
+      break;
+    case '?':
+      Kind = tok::question;
+      break;
+    case '~':
+      Kind = tok::tilde;
+      break;
+    case '`':
+      Kind = tok::equote;
+      break;
+    case '+':
+      if (peekChar(CurPtr, 1) == '+') {
         Kind = tok::plusplus;
+        Len = 2;
       } else {
-        CurPtr--;
         Kind = tok::plus;
       }
       break;
-    }
-    case '-': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '>') {
+    case '-':
+      if (peekChar(CurPtr, 1) == '>') {
         Kind = tok::arrow;
+        Len = 2;
       } else {
-        CurPtr--;
         Kind = tok::minus;
       }
       break;
-    }
-    case '!': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '=') {
+    case '!':
+      if (peekChar(CurPtr, 1) == '=') {
         Kind = tok::notequal;
+        Len = 2;
       } else {
-        CurPtr--;
         Kind = tok::tnot;
       }
       break;
-    }
-    case '/': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '*') {
-        SkipMultiLineComment(CurPtr);
-        continue;
-      } else if (C == '/') {
-        SkipSingleLineComment(CurPtr);
-        continue;
+    case '<':
+      if (peekChar(CurPtr, 1) == '-') {
+        Kind = tok::assign;
+        Len = 2;
+      } else if (peekChar(CurPtr, 1) == '=') {
+        Kind = tok::lessequal;
+        Len = 2;
       } else {
-        CurPtr--;
-        Kind = tok::slash;
+        Kind = tok::less;
       }
       break;
-    }
-    case '>': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '=') {
+    case '>':
+      if (peekChar(CurPtr, 1) == '=') {
         Kind = tok::greaterequal;
+        Len = 2;
       } else {
-        CurPtr--;
         Kind = tok::greater;
       }
       break;
-    }
-    case '<': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == '=') {
-        Kind = tok::lessequal;
-      } else if (C == '-') {
-        Kind = tok::assign;
+    case '=':
+      if (peekChar(CurPtr, 1) == '=' && peekChar(CurPtr, 2) == '=') {
+        Kind = tok::equalequalequal;
+        Len = 3;
+      } else if (peekChar(CurPtr, 1) == '=') {
+        Kind = tok::equalequal;
+        Len = 2;
+      } else if (peekChar(CurPtr, 1) == '>') {
+        Kind = tok::doublearrow;
+        Len = 2;
       } else {
-        CurPtr--;
-        Kind = tok::less;
+        Kind = tok::equal;
       }
       break;
-    }
-    case ':': {
-      CurPtr++;
-      unsigned char C = *CurPtr++;
-      if (C == ':') {
+    case ':':
+      if (peekChar(CurPtr, 1) == ':') {
         Kind = tok::coloncolon;
-      } else if (C == '=') {
+        Len = 2;
+      } else if (peekChar(CurPtr, 1) == '=') {
         Kind = tok::colonequal;
+        Len = 2;
       } else {
-        CurPtr--;
         Kind = tok::colon;
       }
       break;
-    }
-    case '.': {
-      CurPtr++;
-      unsigned char C = *CurPtr;
-      if (C == '.') {
-        Kind = tok::upto;
-      } else {
-        CurPtr--;
-        Kind = tok::period;
-      }
-      break;
-    }
-    case '^':
-      Kind = tok::caret;
-      break;
-    case '~':
-      Kind = tok::tilde;
-      break;
-    case '@':
-      Kind = tok::at;
-      break;
-    case '$':
-      Kind = tok::dollar;
-      break;
-    case '?':
-      Kind = tok::question;
-      break;
-    case '%':
-      Kind = tok::percent;
-      break;
-    case '*':
-      Kind = tok::star;
-      break;
-    case '\\':
-      Kind = tok::fun;
-      break;
-    case '\'':
-      Kind = tok::squote;
-      break;
-    case '`':
-      Kind = tok::equote;
-      break;
     default:
       Kind = tok::unknown;
       break;
     }
-    CurPtr++;
-    FormTokenWithChars(Result, CurPtr, Kind);
-    break;
+    FormTokenWithChars(Result, CurPtr + Len, Kind);
+    return true;
   }
-  return true;
 }
 }
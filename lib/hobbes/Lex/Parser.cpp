@@ -2,840 +2,2073 @@
 #include "hobbes/Lex/Parser.h"
 #include "hobbes/Lex/Lexer.h"
 #include "hobbes/Lex/Token.h"
+#include "hobbes/eval/cc.H"
 #include "hobbes/lang/expr.H"
 #include "hobbes/lang/module.H"
 #include "hobbes/lang/pat/pattern.H"
-#include "hobbes/lang/preds/consrecord.H"
-#include "hobbes/util/autorelease.H"
+#include "hobbes/lang/typepreds.H"
+#include "hobbes/parse/grammar.H"
+#include "hobbes/parse/lalr.H"
+#include "hobbes/read/terms.H"
+#include "hobbes/util/str.H"
 
 #include <llvm/ADT/StringRef.h>
-#include <llvm/ADT/Twine.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 
 namespace hobbes {
 
-using LetBinding = std::pair<PatternPtr, hobbes::ExprPtr>;
-using LetBindings = std::vector<LetBinding>;
+// variable and pattern-variable construction can be overridden (see read/parser.H)
+extern VarCtorFn varCtorFn;
+extern PatVarCtorFn patVarCtorFn;
+
+static std::string tokenText(const Token &T) { return T.getLiteralData().str(); }
 
-Expr *compileNestedLetMatch(hobbes::cc *cc, const LetBindings &bs,
-                            const ExprPtr &e, const LexicalAnnotation &la) {
-  ExprPtr r = e;
-  for (LetBindings::const_reverse_iterator b = bs.rbegin(); b != bs.rend();
-       ++b) {
-    r = compileMatch(cc, list(b->second), list(PatternRow(list(b->first), r)),
-                     la);
+static std::string tokenDesc(const Token &T) {
+  if (T.is(tok::eof)) {
+    return "end of input";
+  } else if (T.is(tok::indent)) {
+    return "indented line";
   }
-  return r->clone();
+  return "'" + tokenText(T) + "'";
 }
 
-PatternPtr pickNestedPat(Patterns *pats, const LexicalAnnotation &la) {
-  if (pats->size() == 0) {
-    return std::make_shared<MatchLiteral>(PrimitivePtr(new Unit(la)), la);
-  } else {
-    MatchRecord::Fields fds;
-    for (unsigned i = 0; i < pats->size(); ++i) {
-      fds.push_back(MatchRecord::Field(".f" + str::from(i), (*pats)[i]));
-    }
-    return std::make_shared<MatchRecord>(fds, la);
+Parser::Parser(cc *C, class Lexer &Lex, const std::string &ModulePath)
+    : C(C), Lex(Lex), ModulePath(ModulePath), PrevEnd(1, 1), WantIndent(0) {
+  // prime the parser with the first token
+  Lex.LexToken(Tok);
+  if (Tok.isOneOf(tok::kw_class, tok::kw_instance)) {
+    ++WantIndent;
   }
 }
 
-Parser::Parser(class Lexer &Lex) : Lex(Lex) {
-  // Initialize the operator table with the built in
-  // operator precedences
-  operators.insert({"and", {10, Assoc::left}});
-  operators.insert({"or", {10, Assoc::left}});
-  operators.insert({"o", {10, Assoc::left}});
+void Parser::ConsumeToken() {
+  if (Tok.isNot(tok::indent)) {
+    PrevEnd = TokEnd();
+  }
 
-  operators.insert({"~", {20, Assoc::left}});
-  operators.insert({"===", {20, Assoc::left}});
-  operators.insert({"==", {20, Assoc::left}});
-  operators.insert({"!=", {20, Assoc::left}});
+  Token Next;
+  if (Ahead.empty()) {
+    Lex.LexToken(Next);
+  } else {
+    Next = Ahead.front();
+    Ahead.pop_front();
+  }
 
-  operators.insert({"<", {30, Assoc::left}});
-  operators.insert({"<=", {30, Assoc::left}});
-  operators.insert({">", {30, Assoc::left}});
-  operators.insert({">=", {30, Assoc::left}});
+  // within class and instance definitions, each indented line starts a member
+  if (Next.isAtIndent() && WantIndent > 0 && Tok.isNot(tok::indent)) {
+    Ahead.push_front(Next);
+    Tok = Next;
+    Tok.setKind(tok::indent);
+    return;
+  }
 
-  operators.insert({"+", {40, Assoc::left}});
-  operators.insert({"-", {40, Assoc::left}});
-  operators.insert({"++", {40, Assoc::left}});
+  Tok = Next;
+  if (Tok.is(tok::unknown)) {
+    throw annotated_error(TokAnnotation(), "Unknown character: " + tokenText(Tok));
+  } else if (Tok.isOneOf(tok::kw_class, tok::kw_instance)) {
+    ++WantIndent;
+  }
+}
 
-  operators.insert({"*", {50, Assoc::left}});
-  operators.insert({"/", {50, Assoc::left}});
-  operators.insert({"%", {50, Assoc::left}});
+auto Parser::Peek(unsigned N) -> const Token & {
+  while (Ahead.size() < N) {
+    Token T;
+    Lex.LexToken(T);
+    Ahead.push_back(T);
+  }
+  return Ahead[N - 1];
 }
 
-void Parser::ConsumeToken() {
-  Lex.LexToken(Tok);
-  std::cout << tok::getTokenName(Tok.getKind()) << std::endl;
+auto Parser::PeekKind(unsigned N) -> tok::TokenKind {
+  const Token &T = Peek(N);
+  if (T.isAtIndent() && WantIndent > 0 && !(N == 1 && Tok.is(tok::indent))) {
+    return tok::indent;
+  }
+  return T.getKind();
+}
+
+/// Whether the parenthesized tokens starting at the current '(' are followed by a token of the given kind
+bool Parser::IsFollowedAfterParens(tok::TokenKind Kind) {
+  unsigned Depth = 1;
+  for (unsigned N = 1;; ++N) {
+    tok::TokenKind K = PeekKind(N);
+    if (K == tok::eof) {
+      return false;
+    } else if (K == tok::l_paren) {
+      ++Depth;
+    } else if (K == tok::r_paren && --Depth == 0) {
+      return PeekKind(N + 1) == Kind;
+    }
+  }
+}
+
+LexicalAnnotation Parser::TokAnnotation() const {
+  return LexicallyAnnotated::make(TokBegin(), TokEnd());
+}
+
+void Parser::Unexpected(const std::string &Expecting) {
+  if (Tok.is(tok::unknown)) {
+    throw annotated_error(TokAnnotation(), "Unknown character: " + tokenText(Tok));
+  }
+  throw annotated_error(TokAnnotation(), "syntax error, unexpected " + tokenDesc(Tok) +
+                                             (Expecting.empty() ? "" : ", expecting " + Expecting));
 }
+
 void Parser::ExpectTokenKind(tok::TokenKind Kind) {
   if (Tok.is(Kind)) {
-    Parser::ConsumeToken();
+    ConsumeToken();
   } else {
-    std::cout << "expected " << tok::getTokenName(Kind) << std::endl;
-    exit(1);
+    const char *S = tok::getTokenSpelling(Kind);
+    Unexpected(S ? "'" + std::string(S) + "'" : tok::getTokenName(Kind));
   }
 }
 
-/// qualified-id:
-///         id ['.' id]+
-bool Parser::ParseQualifiedId(llvm::Twine &QualID) {
+std::string Parser::ConsumeIdentifier() {
+  if (Tok.isNot(tok::identifier)) {
+    Unexpected("identifier");
+  }
+  // '_' stands for a variable that can't be referenced
+  std::string Id = Tok.getLiteralData() == "_" ? freshName() : tokenText(Tok);
   ConsumeToken();
-  while (Tok.is(tok::identifier)) {
-    QualID.concat(Tok.getLiteralData());
-    ConsumeToken();
-    if (Tok.is(tok::period)) {
-      QualID.concat(".");
-      ConsumeToken();
-    } else {
-      break;
-    }
+  return Id;
+}
+
+bool Parser::IsOpName(tok::TokenKind Kind) const {
+  switch (Kind) {
+  case tok::kw_and: case tok::kw_or: case tok::compose: case tok::period:
+  case tok::tilde: case tok::equalequalequal: case tok::equalequal:
+  case tok::less: case tok::lessequal: case tok::greater:
+  case tok::greaterequal: case tok::kw_in: case tok::plusplus:
+  case tok::plus: case tok::minus: case tok::star: case tok::slash:
+  case tok::percent:
+    return true;
+  default:
+    return false;
   }
-  return false;
 }
 
-/// import-statement:
-///     'import' qualified-id
-std::shared_ptr<MImport> Parser::ParseImportStatement() {
+/// opname:
+///     "and" | "or" | " . " | "." | "~" | "===" | "==" | "<" | "<=" | ">"
+///   | ">=" | "in" | "++" | "+" | "-" | "*" | "/" | "%"
+std::string Parser::ConsumeOpName() {
+  if (!IsOpName(Tok.getKind())) {
+    Unexpected("operator name");
+  }
+  std::string Op;
+  if (Tok.isOneOf(tok::compose, tok::period)) {
+    Op = "compose";
+  } else if (Tok.is(tok::plusplus)) {
+    Op = "append";
+  } else {
+    Op = tokenText(Tok);
+  }
   ConsumeToken();
-  llvm::Twine QualID;
-  ParseQualifiedId(QualID);
-  std::cout << QualID.str();
-  return std::make_shared<MImport>(
-      "", QualID.str(), LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
+  return Op;
 }
 
-/// type-declaration:
-///     "type" tyid "="
-bool ParseTypeDeclaration() { return false; }
-
-auto Parser::GetBinopPrecedence(Token &tok) -> std::pair<int, Parser::Assoc> {
-  if (tok.getKind() <= tok::comment_single) {
-    return {-1, Assoc::left};
+bool Parser::IsRecordFieldName(tok::TokenKind Kind) const {
+  switch (Kind) {
+  case tok::identifier: case tok::kw_data: case tok::kw_type:
+  case tok::kw_where: case tok::kw_class: case tok::kw_instance:
+  case tok::kw_exists: case tok::kw_import: case tok::kw_module:
+  case tok::kw_parse: case tok::kw_do: case tok::kw_return:
+  case tok::numeric_constant:
+    return true;
+  default:
+    return false;
   }
+}
 
-  auto OpInfo = operators.find(tok.getLiteralData());
-  int NextTokenPrec = -1;
-  Assoc Assoc = Assoc::left;
-
-  if (OpInfo != operators.end()) {
-    NextTokenPrec = OpInfo->getValue().first;
-    Assoc = OpInfo->getValue().second;
+bool Parser::StartsPrimaryExpression(tok::TokenKind Kind) const {
+  switch (Kind) {
+  case tok::identifier: case tok::l_square: case tok::pipe: case tok::kw_case:
+  case tok::l_brace: case tok::period: case tok::tuple_section:
+  case tok::kw_pack: case tok::kw_unpack: case tok::kw_true:
+  case tok::kw_false: case tok::char_constant: case tok::byte_constant:
+  case tok::bytes_literal: case tok::short_constant:
+  case tok::numeric_constant: case tok::long_constant:
+  case tok::float_constant: case tok::double_constant:
+  case tok::string_literal: case tok::timespan_literal:
+  case tok::time_literal: case tok::datetime_literal: case tok::l_paren:
+  case tok::equote:
+    return true;
+  default:
+    return false;
   }
-
-  return {NextTokenPrec, Assoc};
 }
 
-/// record-pattern-fields:
-///         record-pattern-fields "," record-pattern-field
-///         record-pattern-field
-/// record-pattern-field:
-///         id "=" pattern
-auto Parser::ParseRecordPatternFields(tok::TokenKind ClosingTok) -> std::vector<MatchRecord::Field>* {
-    auto MatchRecords = new MatchRecord::Fields();
-    while (true) {
-        if (Tok.isNot(tok::identifier)) {
-            std::cout << "expected identifier" << std::endl;
-            exit(1);
-        }
-        auto Id = Tok.getLiteralData();
-        ConsumeToken();
-        ExpectTokenKind(tok::equal);
-            
-        auto Pattern = Parser::ParsePattern();
-        if (!Pattern) {
-            std::cout << "expected pattern" << std::endl;
-            exit(1);
-        }
-        MatchRecords->push_back(MatchRecord::Field(Id, Pattern));
-        if (Tok.is(tok::r_paren)) {
-            break;
-        }
-        ExpectTokenKind(tok::comma);
-    }
-    ExpectTokenKind(ClosingTok);
-    return MatchRecords;
-}
-    
-    
-/// Pattern
-///
-///
-///  
-/// refutable-pattern:
-///             "boolV"
-///           | "charV"
-///           | "byteV"
-///           | "shortV"
-///           | "intV"
-///           | "longV"
-///           | "doubleV"
-///           | "bytesV"
-///           | "stringV"
-///           | tsseq
-///           | "timeV"
-///           | "dateTimeV"
-///           | "regexV"
-///           | "[" patternseq "]"
-///           | "|" id "|"
-///           | "|" id "=" pattern "|"
-///           | "|" "intV" "=" pattern "|"
-///           | "(" patternseq ")"
-///           | "{" record-pattern-fields "}"
-///           | id
-PatternPtr Parser::ParsePattern() {
-  if (Tok.is(tok::l_square)) {
-    ConsumeToken();
-    auto PatternSeq = Parser::ParsePatternSequence(tok::r_square);
-    ExpectTokenKind(tok::r_square);
-    return std::make_shared<MatchArray>(
-        PatternSeq, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::pipe)) {
-    ConsumeToken(); // consume '|'
-    if (Tok.is(tok::identifier)) {
-      auto Id = Tok.getLiteralData();
-      ConsumeToken();
-      if (Tok.is(tok::equal)) {
-        ConsumeToken(); // consume '='
-        auto Pattern = Parser::ParsePattern();
-        ExpectTokenKind(tok::pipe);
-        return std::make_shared<MatchVariant>(
-            Id, Pattern, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-      }
-      ExpectTokenKind(tok::pipe);
-      return std::make_shared<MatchVariant>(
-          Id, std::make_shared<MatchLiteral>(
-                  std::make_shared<Unit>(
-                      LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0))),
-                  LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0))),
-          LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-    } else if (Tok.is(tok::numeric_constant)) {
-      auto Id = Tok.getLiteralData();
-      ConsumeToken();
-      ExpectTokenKind(tok::equal);
-      auto Pattern = ParsePattern();
-      ExpectTokenKind(tok::pipe);
-      return std::make_shared<MatchVariant>(
-          (".f" + Id).str(), Pattern,
-          LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-    } else {
-      std::cout << "expected variant pattern" << std::endl;
-      exit(1);
-      // Error
-    }
-  } else if (Tok.is(tok::l_paren)) {
-    ConsumeToken();
-    auto PatternSeq = Parser::ParsePatternSequence(tok::l_paren);
-    ExpectTokenKind(tok::r_paren);
-    return pickNestedPat(&PatternSeq,
-                         LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::l_brace)) {
-    ConsumeToken();
-    auto RecordPatterns = Parser::ParseRecordPatternFields(tok::l_brace);
-    ExpectTokenKind(tok::r_brace);
-    return std::make_shared<MatchRecord>(
-        *RecordPatterns, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::identifier)) {
-    auto Id = Tok.getLiteralData();
-    ConsumeToken();
-    // TODO: Make overridable
-    return std::make_shared<MatchAny>(
-        Id, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::numeric_constant)) {
-    // TODO: Disambiguate literals
-    // return std::make_shared<MatchLiteral>(PrimitivePtr());
-    return nullptr;
+bool Parser::StartsPattern(tok::TokenKind Kind) const {
+  switch (Kind) {
+  case tok::kw_true: case tok::kw_false: case tok::char_constant:
+  case tok::byte_constant: case tok::short_constant:
+  case tok::numeric_constant: case tok::long_constant:
+  case tok::double_constant: case tok::bytes_literal:
+  case tok::string_literal: case tok::timespan_literal:
+  case tok::time_literal: case tok::datetime_literal:
+  case tok::regex_literal: case tok::l_square: case tok::pipe:
+  case tok::l_paren: case tok::l_brace: case tok::identifier:
+    return true;
+  default:
+    return false;
   }
-  return nullptr;
 }
 
+bool Parser::StartsType(tok::TokenKind Kind) const {
+  switch (Kind) {
+  case tok::identifier: case tok::less: case tok::l_square:
+  case tok::l_paren: case tok::l_brace: case tok::pipe:
+  case tok::numeric_constant: case tok::kw_true: case tok::kw_false:
+  case tok::kw_exists: case tok::caret: case tok::string_literal:
+  case tok::equote:
+    return true;
+  default:
+    return false;
+  }
+}
 
+/// module:
+///     "module" id "where" module-defs
+///   | module-defs
+ModulePtr Parser::ParseModule() {
+  std::string Name;
+  if (Tok.is(tok::kw_module)) {
+    ConsumeToken();
+    Name = ConsumeIdentifier();
+    ExpectTokenKind(tok::kw_where);
+  } else {
+    Name = freshName();
+  }
 
-/// pattern-sequence
-///
-std::vector<PatternPtr>
-Parser::ParsePatternSequence(tok::TokenKind ClosingTok) {
-  // empty
-  if (Tok.is(ClosingTok)) {
-    return Patterns();
-  }
-  std::vector<PatternPtr> Patterns;
-  /// patternseqn:
-  ///         | patternseqn "," pattern
-  ///         | pattern
-  while (true) {
-    auto Pattern = Parser::ParsePattern();
-    if (!Pattern) {
-      std::cout << "expected pattern" << std::endl;
-      exit(1);
-    }
-    Patterns.push_back(Pattern);
-    if (Tok.is(ClosingTok)) {
-      break;
-    }
-    ExpectTokenKind(tok::comma);
+  ModuleDefs Defs;
+  while (Tok.isNot(tok::eof)) {
+    Defs.push_back(ParseModuleDef());
   }
-  ExpectTokenKind(ClosingTok);
-  return Patterns;
+  return ModulePtr(new Module(Name, Defs));
 }
 
-/// irrefutable-pattern:
-///         id
-///         "(" pattern-sequence ")"
-///         "{" record-pattern-fields "}"
-PatternPtr Parser::ParseIrrefutablePattern() {
-  if (Tok.is(tok::identifier)) {
-    auto Id = Tok.getLiteralData();
+/// expr-defn:
+///     id "=" l0expr
+///   | l0expr
+ExprDefn Parser::ParseExprDefn() {
+  std::string Name;
+  if (Tok.is(tok::identifier) && PeekKind(1) == tok::equal) {
+    Name = ConsumeIdentifier();
     ConsumeToken();
-    return std::make_shared<MatchAny>(
-        Id, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::l_paren)) {
-    ExpectTokenKind(tok::l_paren);
-    auto Patterns = ParsePatternSequence(tok::r_paren);
-    return pickNestedPat(&Patterns,
-                         LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::l_brace)) {
-    ExpectTokenKind(tok::l_brace);
-    auto MatchRecords = Parser::ParseRecordPatternFields(tok::r_brace);
-    return std::make_shared<MatchRecord>(
-        *MatchRecords, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else {
-    // Error
-    return nullptr;
   }
+  ExprPtr E = ParseExpression();
+  if (Tok.isNot(tok::eof)) {
+    Unexpected("end of input");
+  }
+  return ExprDefn(Name, E);
 }
 
-ExprPtr Parser::ParseIdentifierExpr() {
-  auto IdName = Tok.getLiteralData();
+ExprPtr Parser::ParseExpr() {
+  ExprPtr E = ParseExpression();
+  if (Tok.isNot(tok::eof)) {
+    Unexpected("end of input");
+  }
+  return E;
+}
 
-  ConsumeToken(); // eat the identifier
+/// module-def:
+///     import-statement
+///   | type-def
+///   | var-type-binding
+///   | class-def
+///   | instance-def
+///   | id+ "=" l0expr          (at most 12 names, as in hexpr.y)
+///   | l5expr
+ModuleDefPtr Parser::ParseModuleDef() {
+  switch (Tok.getKind()) {
+  case tok::kw_import:
+    return ParseImportStatement();
+  case tok::kw_type:
+  case tok::kw_data:
+    return ParseTypeDef();
+  case tok::kw_class:
+    return ParseClassDef();
+  case tok::kw_instance:
+    return ParseInstanceDef();
+  case tok::identifier:
+    if (PeekKind(1) == tok::coloncolon) {
+      return ParseVarTypeBinding();
+    } else if (PeekKind(1) == tok::identifier || PeekKind(1) == tok::equal) {
+      Pos Begin = TokBegin();
+      str::seq Names;
+      while (Tok.is(tok::identifier) && Names.size() < 12) {
+        Names.push_back(ConsumeIdentifier());
+      }
+      ExpectTokenKind(tok::equal);
+      ExprPtr E = ParseExpression();
+      return ModuleDefPtr(new MVarDef(Names, E, LexicallyAnnotated::make(Begin, PrevEnd)));
+    }
+    break;
+  default:
+    break;
+  }
 
-  if (Tok.is(tok::l_paren)) {
-    // this is a call
-    ExpectTokenKind(tok::l_paren);
-    std::vector<ExprPtr> Args;
-    if (Tok.isNot(tok::r_paren)) {
-      while (true) {
-        if (auto Arg = ParseExpression()) {
-          Args.push_back(std::move(Arg));
-        } else {
-          return nullptr;
-        }
+  // evaluate an expression just for side-effects, then discard it
+  Pos Begin = TokBegin();
+  ExprPtr E = ParseL5Expression();
+  LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+  return ModuleDefPtr(new MVarDef(list(freshName()), let(freshName(), E, mktunit(La), La), La));
+}
 
-        if (Tok.is(tok::r_paren)) {
-          break;
-        }
+/// qualified-id:
+///         id ['.' id]+
+std::string Parser::ParseQualifiedId() {
+  std::string QualID = ConsumeIdentifier();
+  while (Tok.is(tok::period) && PeekKind(1) == tok::identifier) {
+    ConsumeToken();
+    QualID += ".";
+    QualID += ConsumeIdentifier();
+  }
+  return QualID;
+}
 
-        ExpectTokenKind(tok::comma);
-      }
-    }
+/// import-statement:
+///     'import' qualified-id
+std::shared_ptr<MImport> Parser::ParseImportStatement() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_import);
+  std::string QualID = ParseQualifiedId();
+  return std::make_shared<MImport>(ModulePath, QualID, LexicallyAnnotated::make(Begin, PrevEnd));
+}
 
-    ExpectTokenKind(tok::r_paren);
-    return std::make_shared<App>(
-        var(IdName, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0))), Args,
-        LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-  } else if (Tok.is(tok::l_square)) {
-    std::cout << "not implemented" << std::endl;
-    exit(1);
+/// type-def:
+///     "type" nameseq "=" qtype
+///   | "data" nameseq "=" qtype
+ModuleDefPtr Parser::ParseTypeDef() {
+  Pos Begin = TokBegin();
+  bool Opaque = Tok.is(tok::kw_data);
+  ConsumeToken();
+  str::seq Names = ParseNameSeq();
+  ExpectTokenKind(tok::equal);
+  Pos TBegin = TokBegin();
+  QualTypePtr QT = ParseQualType();
+  MonoTypePtr T = forceMonotype(C, QT, LexicallyAnnotated::make(TBegin, PrevEnd));
+
+  auto TD = std::make_shared<MTypeDef>(Opaque ? MTypeDef::Opaque : MTypeDef::Transparent,
+                                       select(Names, 0), select(Names, 1, (int)Names.size()),
+                                       T, LexicallyAnnotated::make(Begin, PrevEnd));
+  if (Opaque) {
+    C->defineNamedType(TD->name(), TD->arguments(), TD->type());
   } else {
-    return std::make_shared<Var>(
-        IdName, LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-    // found a variable
+    C->defineTypeAlias(TD->name(), TD->arguments(), TD->type());
   }
+  return TD;
 }
 
-/// match-expression:
-///         'match' expr 'with' [ '|' pattern-row ]+
-/// pattern-row:
-///         pattern ['where' expr] '->' expr
-ExprPtr Parser::ParseMatchExpr() {
-  ExpectTokenKind(tok::kw_match);
+/// var-type-binding:
+///     name "::" qtype
+std::shared_ptr<MVarTypeDef> Parser::ParseVarTypeBinding() {
+  Pos Begin = TokBegin();
+  std::string Name = ParseName();
+  ExpectTokenKind(tok::coloncolon);
+  QualTypePtr QT = ParseQualType();
+  return std::make_shared<MVarTypeDef>(Name, QT, LexicallyAnnotated::make(Begin, PrevEnd));
+}
 
-  // expressions to be matched
-  llvm::SmallVector<ExprPtr, 5> MatchExprs;
+/// var-def:
+///     names "=" l0expr
+std::shared_ptr<MVarDef> Parser::ParseVarDef() {
+  Pos Begin = TokBegin();
+  str::seq Names = ParseNames();
+  ExpectTokenKind(tok::equal);
+  ExprPtr E = ParseExpression();
+  return std::make_shared<MVarDef>(Names, E, LexicallyAnnotated::make(Begin, PrevEnd));
+}
 
-  while (true) {
-    auto Match = Parser::ParseExpression();
-    if (!Match) {
-      std::cout << "expected match expression" << std::endl;
-      exit(1);
-      return nullptr;
-    }
-    MatchExprs.push_back(Match);
-    if (Tok.is(tok::kw_where)) {
-      break;
-    }
-  }
-  ExpectTokenKind(tok::kw_where);
+/// class-def:
+///     "class" [constraints "=>"] id names ["|" fundeps] ["where" (indent var-type-binding)+]
+/// fundeps:
+///     idseq "->" idseq ["," fundeps]
+ModuleDefPtr Parser::ParseClassDef() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_class);
 
-  // parse pattern rows
-  llvm::SmallVector<std::shared_ptr<PatternRow>, 10> PatternRows;
+  Constraints Cs;
+  if (Tok.is(tok::l_paren)) {
+    Cs = ParseConstraints();
+    ExpectTokenKind(tok::doublearrow);
+  }
+  std::string Name = ConsumeIdentifier();
+  str::seq Vars = ParseNames();
 
-  while (Tok.is(tok::pipe)) {
-    // llvm::SmallVector<std::shared_ptr<Pattern>, 10> Patterns;
-    std::vector<std::shared_ptr<Pattern>> Patterns;
-    while (true) {
-      auto Pattern = Parser::ParsePattern();
-      if (!Pattern) {
-	std::cout << "Expected Pattern" << std::endl;
-	exit(1);
-      }
-      Patterns.push_back(Pattern);
-      if (Tok.is(tok::arrow) || Tok.is(tok::kw_where)) {
-        break;
-      }
-    }
-    ExprPtr WhereExpr;
-    if (Tok.is(tok::kw_where)) {
+  CFunDepDefs FunDeps;
+  if (Tok.is(tok::pipe)) {
+    do {
+      ConsumeToken();
+      str::seq From, To;
+      do {
+        From.push_back(ConsumeIdentifier());
+      } while (Tok.is(tok::identifier));
+      ExpectTokenKind(tok::arrow);
+      do {
+        To.push_back(ConsumeIdentifier());
+      } while (Tok.is(tok::identifier));
+      FunDeps.push_back(CFunDepDef(From, To));
+    } while (Tok.is(tok::comma));
+  }
 
-      WhereExpr = Parser::ParseExpression();
-      if (!WhereExpr) {
-	std::cout << "Expected where expression" << std::endl;
-	exit(1);
-      }
-    }
-    ExpectTokenKind(tok::arrow);
-    auto PatternRowBody = Parser::ParseExpression();
-    if (!PatternRowBody) {
-      	std::cout << "Expected expression" << std::endl;
-	exit(1);
-    }
-    PatternRows.push_back(
-        std::make_shared<PatternRow>(Patterns, WhereExpr, PatternRowBody));
+  MVarTypeDefs Members;
+  if (Tok.is(tok::kw_where)) {
+    ConsumeToken();
+    do {
+      ExpectTokenKind(tok::indent);
+      Members.push_back(ParseVarTypeBinding());
+    } while (Tok.is(tok::indent));
   }
-  // Actions.ActOnMatch(MatchExpressions,
-  // Actions.ActOnPatternRows(PatternRows));
 
-  // compileMatch(compiler, MatchExprs, normPatternRules(PatternRows, ), );
+  // (the class is finished after the next token is read, as with bison)
+  if (WantIndent > 0) {
+    --WantIndent;
+  }
+  return ModuleDefPtr(new ClassDef(Cs, Name, Vars, FunDeps, Members, LexicallyAnnotated::make(Begin, PrevEnd)));
 }
 
-/// let-expression:
-///     'let' letbindings [';'] 'in' expression
-ExprPtr Parser::ParseLetExpr() {
-  ExpectTokenKind(tok::kw_let);
-
-  llvm::SmallVector<LetBinding, 10> Bindings;
+/// instance-def:
+///     "instance" [constraints "=>"] id l0mtype+ ["where" (indent var-def)+]
+ModuleDefPtr Parser::ParseInstanceDef() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_instance);
 
-  // parse let bindings
-  while (true) {
-    // let-binding:
-    //     irrefutable_pattern = expession
-    auto Pattern = Parser::ParseIrrefutablePattern();
-    ExpectTokenKind(tok::equal);
-    auto Exp = Parser::ParseExpression();
-    Bindings.push_back(std::pair<PatternPtr, ExprPtr>{Pattern, Exp});
-
-    if (Tok.is(tok::kw_in)) {
-      break;
-    }
+  Constraints Cs;
+  if (Tok.is(tok::l_paren)) {
+    Cs = ParseConstraints();
+    ExpectTokenKind(tok::doublearrow);
+  }
+  std::string Name = ConsumeIdentifier();
 
-    ExpectTokenKind(tok::semi);
+  MonoTypes Types;
+  do {
+    Types.push_back(ParseType());
+  } while (StartsType(Tok.getKind()));
 
-    if (Tok.is(tok::kw_in)) {
-      break;
-    }
+  MVarDefs Members;
+  if (Tok.is(tok::kw_where)) {
+    ConsumeToken();
+    do {
+      ExpectTokenKind(tok::indent);
+      Members.push_back(ParseVarDef());
+    } while (Tok.is(tok::indent));
   }
-  ExpectTokenKind(tok::kw_in);
 
-  auto Body = Parser::ParseExpression();
-  if (!Body) {
-    return nullptr;
+  if (WantIndent > 0) {
+    --WantIndent;
   }
+  return ModuleDefPtr(new InstanceDef(Cs, Name, Types, Members, LexicallyAnnotated::make(Begin, PrevEnd)));
+}
 
-  // return Actions.ActOnLet(Bindings, Body);
-  // compileNestedLetMatch(, Bindings, Body, LexicallyAnnotated::make(Pos(0,0),
-  // Pos(0,0))));
-  return nullptr;
+/// names:
+///     nameseq
+///   | id opname id
+str::seq Parser::ParseNames() {
+  if (Tok.is(tok::identifier) && IsOpName(PeekKind(1)) && PeekKind(2) == tok::identifier) {
+    std::string L = ConsumeIdentifier();
+    std::string Op = ConsumeOpName();
+    std::string R = ConsumeIdentifier();
+    return list(Op, L, R);
+  }
+  return ParseNameSeq();
 }
 
-/// if-expression:
-///         'if' expression 'then' expression 'else' expression
-ExprPtr Parser::ParseIfExpr() {
-  ExpectTokenKind(tok::kw_if);
+/// nameseq:
+///     name+
+str::seq Parser::ParseNameSeq() {
+  str::seq Names;
+  do {
+    Names.push_back(ParseName());
+  } while (Tok.isOneOf(tok::identifier, tok::l_paren));
+  return Names;
+}
 
-  auto Cond = ParseExpression();
-  if (!Cond) {
-    return nullptr;
+/// name:
+///     id
+///   | "(" opname ")"
+std::string Parser::ParseName() {
+  if (Tok.is(tok::l_paren)) {
+    ConsumeToken();
+    std::string Op = ConsumeOpName();
+    ExpectTokenKind(tok::r_paren);
+    return Op;
   }
+  return ConsumeIdentifier();
+}
 
-  ExpectTokenKind(tok::kw_then);
-
-  auto Then = ParseExpression();
-  if (!Then) {
-    return nullptr;
+/// Binary operators, from the loosest to the tightest binding:
+///     "and" "or"                                  (left)
+///     " . "                                       (left, compose)
+///     "~" "===" "==" "!=" "<" "<=" ">" ">="       (left)
+///     "in"                                        (right)
+///     "+" "-" "++"                                (left)
+///     "*" "/" "%"                                 (left)
+auto Parser::GetBinopPrecedence(const Token &T) const -> std::pair<int, Parser::Assoc> {
+  switch (T.getKind()) {
+  case tok::kw_and: case tok::kw_or:
+    return {10, Assoc::left};
+  case tok::compose:
+    return {15, Assoc::left};
+  case tok::tilde: case tok::equalequalequal: case tok::equalequal:
+  case tok::notequal: case tok::less: case tok::lessequal:
+  case tok::greater: case tok::greaterequal:
+    return {20, Assoc::left};
+  case tok::kw_in:
+    return {25, Assoc::right};
+  case tok::plus: case tok::minus: case tok::plusplus:
+    return {40, Assoc::left};
+  case tok::star: case tok::slash: case tok::percent:
+    return {50, Assoc::left};
+  default:
+    return {-1, Assoc::left};
   }
+}
 
-  ExpectTokenKind(tok::kw_else);
+/// l0expr:
+///     l0operand (("and" | "or" | " . ") l0operand)*
+ExprPtr Parser::ParseExpression() {
+  Pos Begin = TokBegin();
+  return ParseBinopRHS(ParseL0Operand(), 0, Begin);
+}
 
-  auto Else = ParseExpression();
-  if (!Else) {
-    return nullptr;
+/// l0operand:
+///     "\\" patterns "." l0expr
+///   | "!" l1expr
+///   | l1expr
+///
+/// (this is all that's read for 'let' bodies and 'match' results, which stop
+/// before a following 'and', 'or' or ' . ')
+ExprPtr Parser::ParseL0Operand() {
+  if (Tok.is(tok::fun)) {
+    return ParseLambdaExpr();
+  } else if (Tok.isOneOf(tok::tnot, tok::kw_not)) {
+    Pos Begin = TokBegin();
+    LexicalAnnotation NotLa = TokAnnotation();
+    ConsumeToken();
+    ExprPtr E = ParseL1Expression();
+    return ExprPtr(new App(var("not", NotLa), list(E), LexicallyAnnotated::make(Begin, PrevEnd)));
   }
+  return ParseL1Expression();
+}
 
-  return std::make_shared<App>(
-      var("if", LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0))),
-      list(Cond, Then, Else), LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
+/// l1expr:
+///     l2expr (("~" | "===" | "==" | "!=" | "<" | "<=" | ">" | ">=" | "in") l2expr)*
+ExprPtr Parser::ParseL1Expression() {
+  Pos Begin = TokBegin();
+  return ParseBinopRHS(ParseUnaryExpr(), 20, Begin);
+}
 
-  // return Actions.ActOnIfExpr(std::move(Cond), std::move(Then),
-  // std::move(Else));
+/// l2expr:
+///     unary (("+" | "-" | "++") unary)*
+ExprPtr Parser::ParseL2Expression() {
+  Pos Begin = TokBegin();
+  return ParseBinopRHS(ParseUnaryExpr(), 40, Begin);
 }
 
-/// numeric-constant:
-///     float-literal
-///     integer-literal
-ExprPtr Parser::ParseNumericConstant() {
-  long Lit;
-  Tok.getLiteralData().getAsInteger(10, Lit);
-  ConsumeToken();
-  return std::make_shared<Int>(Lit,
-                               LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
-}
-
-/// expr:
-///      identifier expr'
-///    | literal expr'
-///    | array-constructor-elimination expr'
-///    | variant-constructor-elimination expr'
-///    | case-expr expr'
-///    | record-construction-elimination expr'
-///    | recordfield-path expr'
-///    | pack-expression expr'
-///    | unpack-expression expr'
-///    | paren-expr expr'
-///    | quoted-expr expr'
-
-/// expr':
-///      "(" cargs ")" expr'
-///    | "[" l0expr "]" expr'
-///    | record-field-path expr'
-///    | empty
-
-/// primary-expression:
-///         numeric-constant
-///       | identifier-expression
-///       | if-expression
-///       | let-expression
-///       | match-expression
-///       | do-expression
-///       | case-expression
-///       | string-literal
-///       | char-literal
-///       | array-literal
-ExprPtr Parser::ParsePrimaryExpression() {
-  switch (Tok.getKind()) {
-  case tok::numeric_constant:
-    return Parser::ParseNumericConstant();
-  case tok::identifier:
-    return Parser::ParseIdentifierExpr();
-  case tok::kw_if:
-    return Parser::ParseIfExpr();
-  case tok::kw_let:
-    return Parser::ParseLetExpr();
-  case tok::kw_match:
-    return Parser::ParseMatchExpr();
-  case tok::kw_do:
-  // return Parser::ParseDoExpr();
-  case tok::kw_case:
-  // return Parser::ParseCaseExpr();
-  case tok::l_square:
-  // return Parser::ParseArrayExpr();
-  default:
-    break;
+/// unary:
+///     "-" unary (("*" | "/" | "%") l4expr)*
+///   | l4expr
+ExprPtr Parser::ParseUnaryExpr() {
+  if (Tok.is(tok::minus)) {
+    Pos Begin = TokBegin();
+    LexicalAnnotation NegLa = TokAnnotation();
+    ConsumeToken();
+    Pos EBegin = TokBegin();
+    ExprPtr E = ParseBinopRHS(ParseUnaryExpr(), 41, EBegin);
+    return ExprPtr(new App(var("neg", NegLa), list(E), LexicallyAnnotated::make(Begin, PrevEnd)));
   }
-  return nullptr;
+  return ParseL4Expression();
 }
 
-/// parse the right hand side of a binary operator
-ExprPtr Parser::ParseBinopRHS(ExprPtr LHS, int MinPrec) {
-  while (1) {
-    // If this was an operator token we should handle the error
-    // here
-    int NextTokenPrec;
-    Parser::Assoc Assoc;
-    std::tie(NextTokenPrec, Assoc) = GetBinopPrecedence(Tok);
-
-    if (NextTokenPrec < MinPrec) {
+ExprPtr Parser::ParseBinopRHS(ExprPtr LHS, int MinPrec, const Pos &Begin) {
+  while (true) {
+    auto OpInfo = GetBinopPrecedence(Tok);
+    int Prec = OpInfo.first;
+    if (Prec < MinPrec || Prec < 0) {
       return LHS;
     }
-    Parser::ConsumeToken();
 
-    auto RHS = ParsePrimaryExpression();
-    int ThisPrec = NextTokenPrec;
-
-    bool isRightAssoc = Assoc == Assoc::right;
+    Token OpTok = Tok;
+    LexicalAnnotation OpLa = TokAnnotation();
+    ConsumeToken();
 
-    if (ThisPrec < NextTokenPrec ||
-        (ThisPrec == NextTokenPrec && isRightAssoc)) {
-      RHS = ParseBinopRHS(std::move(RHS), ThisPrec + !isRightAssoc);
-      std::tie(NextTokenPrec, Assoc) = GetBinopPrecedence(Tok);
+    // lambdas and negations can follow the loosest operators, negative
+    // values can follow any operator but multiplication
+    Pos RBegin = TokBegin();
+    ExprPtr RHS;
+    if (Prec <= 15) {
+      RHS = ParseL0Operand();
+    } else if (Prec <= 40) {
+      RHS = ParseUnaryExpr();
+    } else {
+      RHS = ParseL4Expression();
+    }
+    RHS = ParseBinopRHS(RHS, OpInfo.second == Assoc::right ? Prec : Prec + 1, RBegin);
+
+    LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+    std::string Op;
+    switch (OpTok.getKind()) {
+    case tok::compose:  Op = "compose"; break;
+    case tok::plusplus: Op = "append"; break;
+    case tok::notequal: Op = "=="; break;
+    default:            Op = tokenText(OpTok); break;
     }
 
-    auto OldLHS = std::move(LHS);
-    LHS = std::make_shared<App>(
-        var(Tok.getLiteralData().str(),
-            LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0))),
-        list(std::move(OldLHS), std::move(RHS)),
-        LexicallyAnnotated::make(Pos(0, 0), Pos(0, 0)));
+    LHS = ExprPtr(new App(var(Op, OpLa), list(LHS, RHS), La));
+    if (OpTok.is(tok::notequal)) {
+      LHS = ExprPtr(new App(var("not", OpLa), list(LHS), La));
+    }
   }
 }
 
-/// expression: primary binoprhs
-ExprPtr Parser::ParseExpression() {
-  auto LHS = Parser::ParsePrimaryExpression();
-  if (!LHS) {
-    std::cout << "Expected Primary Expression" << std::endl;
-    return nullptr;
-  }
-  return Parser::ParseBinopRHS(std::move(LHS), 0);
-}
-
-/// type:
-///    id
-///    "<" cppid ">"
-///    "[" "]"
-///    "[" ltmtype "]"
-///    "[" ":" l0mtype "|" tyind ":" "]"
-///    "(" "->" ")"
-///    "(" ltmtype ")"
-///    "{" mreclist "}"
-///    "|" mvarlist "|"
-///    "(" ")"
-///    "intV"
-///    "boolV"
-///    "exists" id "." l1mtype
-///    l1mtype "@" l1mtype
-///    l1mtype "@" "?"
-///    "^" id "." l1mtype
-///    "stringV"
-///    "`" l0expr "`"
-auto Parser::ParseType() -> MonoTypePtr {
+/// l4expr:
+///     "if" l4expr "then" l4expr "else" l4expr
+///   | "let" letbindings [";"] "in" l0operand
+///   | "match" l6expr+ "with" patternrows
+///   | "parse" "{" prules "}"
+///   | "do" "{" dobindings ["return" l0expr] "}"
+///   | l5expr "::" qtype
+///   | l5expr "matches" pattern
+///   | l5expr
+ExprPtr Parser::ParseL4Expression() {
   switch (Tok.getKind()) {
-  case tok::identifier:
+  case tok::kw_if:
+    return ParseIfExpr();
+  case tok::kw_let:
+    return ParseLetExpr();
+  case tok::kw_match:
+    return ParseMatchExpr();
+  case tok::kw_parse:
+    return ParseParserExpr();
+  case tok::kw_do:
+    return ParseDoExpr();
+  default:
     break;
-  case tok::less:
-    Parser::ConsumeToken();
-    if (Tok.is(tok::identifier)) {
-
-    } else {
-      // error
-    }
-    Parser::ConsumeToken();
-
-    if (Tok.is(tok::greater)) {
+  }
 
-    } else {
-      // error
-    }
-    Parser::ConsumeToken();
-    break;
-  case tok::l_square: {
+  Pos Begin = TokBegin();
+  ExprPtr E = ParseL5Expression();
+  if (Tok.is(tok::coloncolon)) {
+    // forced type assignment
     ConsumeToken();
-    llvm::SmallVector<MonoTypePtr, 10> AccTy;
-    while (1) {
-      auto Type = ParseType();
-      if (Type) {
+    QualTypePtr QT = ParseQualType();
+    return ExprPtr(new Assump(E, QT, LexicallyAnnotated::make(Begin, PrevEnd)));
+  } else if (Tok.is(tok::kw_matches)) {
+    ConsumeToken();
+    PatternPtr P = ParsePattern();
+    return ExprPtr(compileMatchTest(C, E, P, LexicallyAnnotated::make(Begin, PrevEnd))->clone());
+  }
+  return E;
+}
+
+/// if-expr:
+///     "if" l4expr "then" l4expr "else" l4expr
+ExprPtr Parser::ParseIfExpr() {
+  Pos Begin = TokBegin();
+  LexicalAnnotation IfLa = TokAnnotation();
+  ExpectTokenKind(tok::kw_if);
+  ExprPtr Cond = ParseL4Expression();
+  ExpectTokenKind(tok::kw_then);
+  ExprPtr Then = ParseL4Expression();
+  ExpectTokenKind(tok::kw_else);
+  ExprPtr Else = ParseL4Expression();
+  return ExprPtr(new App(var("if", IfLa), list(Cond, Then, Else), LexicallyAnnotated::make(Begin, PrevEnd)));
+}
+
+/// let-expr:
+///     "let" letbinding (";" letbinding)* [";"] "in" l0operand
+/// letbinding:
+///     irrefutable-pattern "=" l2expr
+ExprPtr Parser::ParseLetExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_let);
+
+  LetBindings Bindings;
+  while (true) {
+    PatternPtr P = ParseIrrefutablePattern();
+    ExpectTokenKind(tok::equal);
+    Bindings.push_back(LetBinding(P, ParseL2Expression()));
+    if (Tok.is(tok::semi)) {
+      ConsumeToken();
+      if (Tok.is(tok::kw_in)) {
+        break;
       }
+    } else if (Tok.is(tok::kw_in)) {
+      break;
+    } else {
+      Unexpected("';' or 'in'");
+    }
+  }
+  ExpectTokenKind(tok::kw_in);
+  ExprPtr Body = ParseL0Operand();
+  return ExprPtr(compileNestedLetMatch(C, Bindings, Body, LexicallyAnnotated::make(Begin, PrevEnd)));
+}
+
+/// match-expr:
+///     "match" l6expr+ "with" patternrows
+ExprPtr Parser::ParseMatchExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_match);
+
+  Exprs Es;
+  do {
+    Es.push_back(ParsePostfixExpression());
+  } while (StartsPrimaryExpression(Tok.getKind()));
+  ExpectTokenKind(tok::kw_with);
+
+  PatternRows Rows = ParsePatternRows();
+  LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+  return ExprPtr(compileMatch(C, Es, normPatternRules(Rows, La), La)->clone());
+}
+
+/// patternrows:
+///     ("|" patterns ["where" l0expr] "->" l0operand)+
+PatternRows Parser::ParsePatternRows() {
+  PatternRows Rows;
+  do {
+    ExpectTokenKind(tok::pipe);
+    Patterns Ps = ParsePatterns();
+    if (Tok.is(tok::kw_where)) {
       ConsumeToken();
-      if (Tok.is(tok::r_square)) {
+      ExprPtr Guard = ParseExpression();
+      ExpectTokenKind(tok::arrow);
+      Rows.push_back(PatternRow(Ps, Guard, ParseL0Operand()));
+    } else {
+      ExpectTokenKind(tok::arrow);
+      Rows.push_back(PatternRow(Ps, ParseL0Operand()));
+    }
+  } while (Tok.is(tok::pipe));
+  return Rows;
+}
+
+/// parser-expr:
+///     "parse" "{" (id ":=" prdef ("|" prdef)*)+ "}"
+/// prdef:
+///     ([id ":"] (id | "stringV" | "charV"))* "{" l0expr "}"
+ExprPtr Parser::ParseParserExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_parse);
+  ExpectTokenKind(tok::l_brace);
+
+  Grammar G;
+  do {
+    std::string Sym = ConsumeIdentifier();
+    ExpectTokenKind(tok::colonequal);
+
+    GrammarRules Rules;
+    while (true) {
+      BoundGrammarValues Values;
+      while (Tok.isNot(tok::l_brace)) {
+        std::string VarName = "_";
+        if (Tok.is(tok::identifier) && PeekKind(1) == tok::colon) {
+          VarName = ConsumeIdentifier();
+          ConsumeToken();
+        }
+
+        LexicalAnnotation La = TokAnnotation();
+        GrammarValuePtr V;
+        if (Tok.is(tok::identifier)) {
+          V = GrammarValuePtr(new GSymRef(ConsumeIdentifier(), La));
+        } else if (Tok.is(tok::string_literal)) {
+          V = GrammarValuePtr(new GStr(str::unescape(str::trimq(tokenText(Tok))), La));
+          ConsumeToken();
+        } else if (Tok.is(tok::char_constant)) {
+          V = GrammarValuePtr(new GStr(std::string(1, str::readCharDef(tokenText(Tok))), La));
+          ConsumeToken();
+        } else {
+          Unexpected("grammar symbol");
+        }
+        Values.push_back(BoundGrammarValue(VarName, V));
+      }
+      ExpectTokenKind(tok::l_brace);
+      ExprPtr Reduction = ParseExpression();
+      ExpectTokenKind(tok::r_brace);
+      Rules.push_back(GrammarRule(Values, Reduction));
+
+      if (Tok.isNot(tok::pipe)) {
         break;
       }
+      ConsumeToken();
     }
-    ExpectTokenKind(tok::r_square);
-    break;
+    G.push_back(Grammar::value_type(Sym, Rules));
+  } while (Tok.isNot(tok::r_brace));
+  ExpectTokenKind(tok::r_brace);
+
+  LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+  try {
+    return ExprPtr(makeParser(C, G, La)->clone());
+  } catch (hobbes::compile_table_failure &ctf) {
+    std::ostringstream ss;
+    ss << ctf.what() << std::endl;
+    ctf.print(ss);
+    throw annotated_error(La, ss.str());
   }
-  case tok::l_paren:
+}
+
+/// do-expr:
+///     "do" "{" dobinding+ ["return" l0expr] "}"
+/// dobinding:
+///     irrefutable-pattern "=" l0expr ";"
+///   | l0expr ";"
+ExprPtr Parser::ParseDoExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_do);
+  ExpectTokenKind(tok::l_brace);
+
+  LetBindings Bindings;
+  do {
+    // (as the LALR grammar decides, a record pattern or "()", in any number of
+    // parentheses, starts a binding and any other parenthesized term starts an
+    // expression)
+    bool IsBinding = false;
+    if (Tok.is(tok::identifier)) {
+      IsBinding = PeekKind(1) == tok::equal;
+    } else if (Tok.is(tok::l_brace)) {
+      IsBinding = true;
+    } else if (Tok.is(tok::l_paren)) {
+      unsigned N = 1;
+      while (PeekKind(N) == tok::l_paren) {
+        ++N;
+      }
+      IsBinding = PeekKind(N) == tok::l_brace || PeekKind(N) == tok::r_paren;
+    }
+
+    if (IsBinding) {
+      PatternPtr P = ParseIrrefutablePattern();
+      ExpectTokenKind(tok::equal);
+      ExprPtr E = ParseExpression();
+      ExpectTokenKind(tok::semi);
+      Bindings.push_back(LetBinding(P, E));
+    } else {
+      Pos EBegin = TokBegin();
+      ExprPtr E = ParseExpression();
+      LexicalAnnotation La = LexicallyAnnotated::make(EBegin, PrevEnd);
+      ExpectTokenKind(tok::semi);
+      Bindings.push_back(LetBinding(PatternPtr(new MatchAny("_", La)), E));
+    }
+  } while (Tok.isNot(tok::kw_return) && Tok.isNot(tok::r_brace));
+
+  if (Tok.is(tok::kw_return)) {
     ConsumeToken();
-    if (Tok.is(tok::arrow)) {
+    ExprPtr E = ParseExpression();
+    ExpectTokenKind(tok::r_brace);
+    return ExprPtr(compileNestedLetMatch(C, Bindings, E, LexicallyAnnotated::make(Begin, PrevEnd)));
+  } else {
+    ExpectTokenKind(tok::r_brace);
+    LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+    return ExprPtr(compileNestedLetMatch(C, Bindings, ExprPtr(new Unit(La)), La));
+  }
+}
+
+/// l5expr:
+///     l6expr "<-" l6expr
+///   | l6expr
+ExprPtr Parser::ParseL5Expression() {
+  Pos Begin = TokBegin();
+  ExprPtr E = ParsePostfixExpression();
+  if (Tok.is(tok::assign)) {
+    ConsumeToken();
+    ExprPtr R = ParsePostfixExpression();
+    return ExprPtr(new Assign(E, R, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  return E;
+}
+
+/// l6expr:
+///     primary
+///   | l6expr "(" cargs ")"
+///   | l6expr "[" l0expr "]"
+///   | l6expr "[" l0expr ":" l0expr "]"
+///   | l6expr "[" l0expr ":" "]"
+///   | l6expr "[" ":" l0expr "]"
+///   | l6expr fieldpath
+ExprPtr Parser::ParsePostfixExpression(bool AllowFieldPath) {
+  Pos Begin = TokBegin();
+  ExprPtr E = ParsePrimaryExpression();
+  while (true) {
+    if (Tok.is(tok::l_paren)) {
       ConsumeToken();
-      ExpectTokenKind(tok::r_paren);
+      Exprs Args = ParseCallArgs(tok::r_paren);
+      E = ExprPtr(new App(E, Args, LexicallyAnnotated::make(Begin, PrevEnd)));
+    } else if (Tok.is(tok::l_square)) {
+      ConsumeToken();
+      if (Tok.is(tok::colon)) {
+        // xs[:e]
+        LexicalAnnotation ColonLa = TokAnnotation();
+        ConsumeToken();
+        ExprPtr End = ParseExpression();
+        ExpectTokenKind(tok::r_square);
+        LexicalAnnotation ELa = LexicallyAnnotated::make(Begin, Begin);
+        LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+        std::string VN = freshName();
+        E = ExprPtr(new Let(VN, E,
+                            fncall(var("slice", ColonLa),
+                                   list(var(VN, ELa), fncall(var("size", ColonLa), list(var(VN, ColonLa)), ELa), End),
+                                   La),
+                            La));
+        continue;
+      }
+
+      ExprPtr I = ParseExpression();
+      if (Tok.is(tok::r_square)) {
+        ConsumeToken();
+        E = ExprPtr(new AIndex(E, I, LexicallyAnnotated::make(Begin, PrevEnd)));
+      } else if (Tok.is(tok::colon)) {
+        LexicalAnnotation ColonLa = TokAnnotation();
+        ConsumeToken();
+        if (Tok.is(tok::r_square)) {
+          // xs[b:]
+          ConsumeToken();
+          LexicalAnnotation ELa = LexicallyAnnotated::make(Begin, Begin);
+          LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+          std::string VN = freshName();
+          E = ExprPtr(new Let(VN, E,
+                              fncall(var("slice", ColonLa),
+                                     list(var(VN, ELa), I, fncall(var("size", ColonLa), list(var(VN, ELa)), ELa)),
+                                     La),
+                              La));
+        } else {
+          // xs[b:e]
+          ExprPtr End = ParseExpression();
+          ExpectTokenKind(tok::r_square);
+          E = ExprPtr(new App(var("slice", ColonLa), list(E, I, End), LexicallyAnnotated::make(Begin, PrevEnd)));
+        }
+      } else {
+        Unexpected("']' or ':'");
+      }
+    } else if ((Tok.is(tok::period) && AllowFieldPath && IsRecordFieldName(PeekKind(1))) ||
+               Tok.is(tok::tuple_section)) {
+      str::seq Fields = ParseFieldPath();
+      E = ExprPtr(makeProjSeq(E, Fields, LexicallyAnnotated::make(Begin, PrevEnd)));
+    } else {
+      return E;
+    }
+  }
+}
+
+/// fieldpath:
+///     ("." recfieldname | "tupSection")+
+str::seq Parser::ParseFieldPath() {
+  str::seq Fields;
+  while (true) {
+    if (Tok.is(tok::period) && IsRecordFieldName(PeekKind(1))) {
+      ConsumeToken();
+      Fields.push_back(ParseRecordFieldName());
+    } else if (Tok.is(tok::tuple_section)) {
+      str::seq Fs = tupSectionFields(tokenText(Tok));
+      Fields.insert(Fields.end(), Fs.begin(), Fs.end());
+      ConsumeToken();
+    } else {
+      return Fields;
+    }
+  }
+}
+
+/// recfieldname:
+///     id | "data" | "type" | "where" | "class" | "instance" | "exists"
+///   | "import" | "module" | "parse" | "do" | "return" | "intV"
+std::string Parser::ParseRecordFieldName() {
+  if (Tok.is(tok::identifier)) {
+    return ConsumeIdentifier();
+  } else if (Tok.is(tok::numeric_constant)) {
+    std::string F = ".f" + str::from(std::atoi(tokenText(Tok).c_str()));
+    ConsumeToken();
+    return F;
+  } else if (IsRecordFieldName(Tok.getKind())) {
+    // ('class' and 'instance' don't start definitions here)
+    if (Tok.isOneOf(tok::kw_class, tok::kw_instance) && WantIndent > 0) {
+      --WantIndent;
     }
-    if (Tok.is(tok::r_paren)) {
+    std::string F = tokenText(Tok);
+    ConsumeToken();
+    return F;
+  }
+  Unexpected("field name");
+}
+
+/// cargs:
+///     [l0expr ("," l0expr)*]
+Exprs Parser::ParseCallArgs(tok::TokenKind ClosingTok) {
+  Exprs Args;
+  if (Tok.isNot(ClosingTok)) {
+    Args.push_back(ParseExpression());
+    while (Tok.is(tok::comma)) {
       ConsumeToken();
+      Args.push_back(ParseExpression());
     }
-    break;
+  }
+  ExpectTokenKind(ClosingTok);
+  return Args;
+}
+
+/// primary:
+///     id
+///   | array | variant | case | record | "(" cargs ")" | "(" op ")"
+///   | fieldpath
+///   | "pack" l6expr
+///   | "unpack" id "=" l6expr "in" l6expr
+///   | "`" l0expr "`"
+///   | constant
+ExprPtr Parser::ParsePrimaryExpression() {
+  Pos Begin = TokBegin();
+  LexicalAnnotation La = TokAnnotation();
+  switch (Tok.getKind()) {
+  case tok::identifier: {
+    std::string Id = ConsumeIdentifier();
+    return ExprPtr(varCtorFn(Id, La));
+  }
+  case tok::l_square:
+    return ParseArrayExpr();
+  case tok::pipe:
+    return ParseVariantExpr();
+  case tok::kw_case:
+    return ParseCaseExpr();
   case tok::l_brace:
-    break;
-  case tok::kw_exists:
-    Parser::ConsumeToken();
-    // Parser::ParseIdentifierExpr();
-    if (Tok.isNot(tok::period)) {
+    return ParseRecordExpr();
+  case tok::l_paren:
+    return ParseParenExpr();
+  case tok::period:
+  case tok::tuple_section: {
+    // record sections
+    str::seq Fields = ParseFieldPath();
+    if (Fields.empty()) {
+      Unexpected("field name");
     }
-    Parser::ConsumeToken();
-    Parser::ParseType();
+    LexicalAnnotation SLa = LexicallyAnnotated::make(Begin, PrevEnd);
+    return ExprPtr(new Fn(str::strings("x"), proj(var("x", SLa), Fields, SLa), SLa));
+  }
+  case tok::kw_pack: {
+    ConsumeToken();
+    ExprPtr E = ParsePostfixExpression();
+    return ExprPtr(new Pack(E, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  case tok::kw_unpack: {
+    ConsumeToken();
+    std::string Id = ConsumeIdentifier();
+    ExpectTokenKind(tok::equal);
+    ExprPtr E = ParsePostfixExpression();
+    ExpectTokenKind(tok::kw_in);
+    ExprPtr B = ParsePostfixExpression(false);
+    return ExprPtr(new Unpack(Id, E, B, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  case tok::equote: {
+    // quoted expressions
+    ConsumeToken();
+    Pos EBegin = TokBegin();
+    ExprPtr E = ParseExpression();
+    LexicalAnnotation ELa = LexicallyAnnotated::make(EBegin, PrevEnd);
+    ExpectTokenKind(tok::equote);
+    return ExprPtr(new Assump(fncall(var("unsafeCast", ELa), list(mktunit(ELa)), ELa),
+                              qualtype(tapp(primty("quote"), list(texpr(E)))), ELa));
+  }
+  case tok::kw_true:
+  case tok::kw_false: {
+    bool B = Tok.is(tok::kw_true);
+    ConsumeToken();
+    return ExprPtr(new Bool(B, La));
+  }
+  case tok::char_constant: {
+    char Ch = str::readCharDef(tokenText(Tok));
+    ConsumeToken();
+    return ExprPtr(new Char(Ch, La));
+  }
+  case tok::byte_constant: {
+    unsigned char B = str::dehex(tokenText(Tok));
+    ConsumeToken();
+    return ExprPtr(new Byte(B, La));
+  }
+  case tok::bytes_literal: {
+    std::vector<unsigned char> Bs = str::dehexs(tokenText(Tok));
+    ConsumeToken();
+    return ExprPtr(mkarray(Bs, La));
+  }
+  case tok::string_literal: {
+    std::string S = str::unescape(str::trimq(tokenText(Tok)));
+    ConsumeToken();
+    return ExprPtr(mkarray(S, La));
+  }
+  case tok::timespan_literal: {
+    str::seq Ts;
+    while (Tok.is(tok::timespan_literal)) {
+      Ts.push_back(tokenText(Tok));
+      ConsumeToken();
+    }
+    return ExprPtr(mkTimespanExpr(Ts, LexicallyAnnotated::make(Begin, PrevEnd))->clone());
+  }
+  case tok::time_literal: {
+    std::string T = tokenText(Tok);
+    ConsumeToken();
+    return ExprPtr(mkTimeExpr(T, La)->clone());
+  }
+  case tok::datetime_literal: {
+    std::string T = tokenText(Tok);
+    ConsumeToken();
+    return ExprPtr(mkDateTimeExpr(T, La)->clone());
+  }
+  case tok::short_constant:
+  case tok::numeric_constant:
+  case tok::long_constant:
+  case tok::float_constant:
+  case tok::double_constant:
+    return ParseNumericConstant();
+  default:
+    Unexpected("expression");
+  }
+}
+
+/// numeric-constant:
+///     "shortV" | "intV" | "longV" | "floatV" | "doubleV"
+ExprPtr Parser::ParseNumericConstant() {
+  LexicalAnnotation La = TokAnnotation();
+  llvm::StringRef Text = Tok.getLiteralData();
+  ExprPtr E;
+  switch (Tok.getKind()) {
+  case tok::short_constant:
+    E = ExprPtr(new Short((short)std::atoi(Text.str().c_str()), La));
     break;
-  case tok::caret:
+  case tok::numeric_constant:
+    E = ExprPtr(new Int(std::atoi(Text.str().c_str()), La));
     break;
-  // TODO: missing "`"
-  default:
+  case tok::long_constant:
+    E = ExprPtr(new Long(std::atol(Text.drop_back().str().c_str()), La));
+    break;
+  case tok::float_constant:
+    E = ExprPtr(new Float(std::atof(Text.str().c_str()), La));
     break;
+  case tok::double_constant:
+    E = ExprPtr(new Double(std::atof(Text.str().c_str()) * (Text.endswith("%") ? 0.01 : 1.0), La));
+    break;
+  default:
+    Unexpected("number");
   }
+  ConsumeToken();
+  return E;
 }
 
-/// type-predicate:
-///    id [l1mtype]+
-///    "{" l1mtype "*" lm1type "}" "=" l1mtype
-///    "{" id ":" l1mtype "*" l1mtype "}" "=" l1mtype
-///    "(" l1mtype "*" l1mtype ")" "=" l1mtype
-///    l1mtype "==" l1mtype
-///    l1mtype "!=" l1mtype
-///    l1mtype "~" lm1type
-///    l1mtype "=" "{" l1mtype "*" l1mtype "}"
-///    l1mtype "=" "{" id ":" l1mtype "*" l1mtype "}"
-///    l1mtype "=" "(" l1mtype "*" l1mtype ")"
-///    l1mtype "." recfieldname "::" l1mtype
-///    l1mtype "." recfieldname "<-" l1mtype
-///    l1mtype "/" l1mtype "::" l1mtype
-///    l1mtype "/" l1mtype "<-" l1mtype
-///    l1mtype "=" "|" l1mtype "+" l1mtype "|"
-///    l1mtype "=" "|" id ":" l1mtype "+" l1mtype "|"
-///    "|" l1mtype "+" l1mtype "|" "=" l1mtype
-///    "|" id ":" l1mtype "+" l1mtype "|" "=" l1mtype
-///    "|" id ":" l0mtype "|" "::" l1mtype
-///    "|" l1mtype "/" l0mtype "|" "::" l1mtype
-///    l1mtype "++" l1mtype "=" l1mtype
-auto Parser::ParseTypePredicate() -> ConstraintPtr {
-  if (Tok.is(tok::l_brace)) {
-    ExpectTokenKind(tok::l_brace);
+/// lambda:
+///     "\\" patterns "." l0expr
+ExprPtr Parser::ParseLambdaExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::fun);
+  Patterns Ps = ParsePatterns();
+  ExpectTokenKind(tok::period);
+  ExprPtr Body = ParseExpression();
+  return ExprPtr(makePatternFn(C, Ps, Body, LexicallyAnnotated::make(Begin, PrevEnd)));
+}
 
-    // record field constraint
-    if (Tok.is(tok::identifier)) {
-      if (Tok.is(tok::colon)) {
-      }
+/// array:
+///     "[" l0expr ".." [l0expr] "]"
+///   | "[" l0expr "|" pattern "<-" l0expr ["," l0expr] "]"
+///   | "[" cargs "]"
+ExprPtr Parser::ParseArrayExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::l_square);
+  if (Tok.is(tok::r_square)) {
+    ConsumeToken();
+    return ExprPtr(new MkArray(Exprs(), LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+
+  ExprPtr E = ParseExpression();
+  if (Tok.is(tok::upto)) {
+    LexicalAnnotation UpLa = TokAnnotation();
+    ConsumeToken();
+    if (Tok.is(tok::r_square)) {
+      ConsumeToken();
+      return ExprPtr(new App(var("iterateS", UpLa),
+                             list(E, fn(str::strings(".x"),
+                                        fncall(var("+", UpLa), list(var(".x", UpLa), ExprPtr(new Int(1, UpLa))), UpLa),
+                                        UpLa)),
+                             LexicallyAnnotated::make(Begin, PrevEnd)));
+    }
+    ExprPtr End = ParseExpression();
+    ExpectTokenKind(tok::r_square);
+    return ExprPtr(new App(var("range", UpLa), list(E, End), LexicallyAnnotated::make(Begin, PrevEnd)));
+  } else if (Tok.is(tok::pipe)) {
+    // array comprehensions
+    ConsumeToken();
+    PatternPtr P = ParsePattern();
+    ExpectTokenKind(tok::assign);
+    ExprPtr Arr = ParseExpression();
+    ExprPtr Cond;
+    if (Tok.is(tok::comma)) {
+      ConsumeToken();
+      Cond = ParseExpression();
     }
+    ExpectTokenKind(tok::r_square);
+    return ExprPtr(compileArrayComprehension(C, E, P, Arr, Cond, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
 
-    auto T0 = ParseType();
-    ExpectTokenKind(tok::star);
-    auto T1 = ParseType();
-    ExpectTokenKind(tok::r_brace);
+  Exprs Es = list(E);
+  while (Tok.is(tok::comma)) {
+    ConsumeToken();
+    Es.push_back(ParseExpression());
+  }
+  ExpectTokenKind(tok::r_square);
+  return ExprPtr(new MkArray(Es, LexicallyAnnotated::make(Begin, PrevEnd)));
+}
+
+/// variant:
+///     "|" id "=" l0expr "|"
+///   | "|" "intV" "=" l0expr "|"
+///   | "|" id "|"
+ExprPtr Parser::ParseVariantExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::pipe);
+
+  std::string Label;
+  if (Tok.is(tok::numeric_constant)) {
+    Label = ".f" + str::from(std::atoi(tokenText(Tok).c_str()));
+    ConsumeToken();
+    ExpectTokenKind(tok::equal);
+  } else {
+    LexicalAnnotation LabelLa = TokAnnotation();
+    Label = ConsumeIdentifier();
+    if (Tok.is(tok::pipe)) {
+      ConsumeToken();
+      return ExprPtr(new MkVariant(Label, ExprPtr(new Unit(LabelLa)), LexicallyAnnotated::make(Begin, PrevEnd)));
+    }
     ExpectTokenKind(tok::equal);
-    auto T2 = ParseType();
-    return std::make_shared<Constraint>(
-        RecordDeconstructor::constraintName(),
-        list(tlong(0), tlong(0), T2, freshTypeVar(), T0, T1));
+  }
+  ExprPtr E = ParseExpression();
+  ExpectTokenKind(tok::pipe);
+  return ExprPtr(new MkVariant(Label, E, LexicallyAnnotated::make(Begin, PrevEnd)));
+}
 
-  } else if (Tok.is(tok::pipe)) {
-    // Not implemented
-  } else if (Tok.is(tok::l_paren)) {
-    ExpectTokenKind(tok::l_paren);
-    auto T0 = ParseType();
-    ExpectTokenKind(tok::star);
-    auto T1 = ParseType();
-    ExpectTokenKind(tok::r_paren);
+/// case:
+///     "case" l0expr "of" "|" varbind ("," varbind)* "|" ["default" l0expr]
+/// varbind:
+///     id "=" l0expr
+///   | id ":" id "=" l0expr
+///   | "intV" ":" id "=" l0expr
+ExprPtr Parser::ParseCaseExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::kw_case);
+  ExprPtr E = ParseExpression();
+  ExpectTokenKind(tok::kw_of);
+  ExpectTokenKind(tok::pipe);
+
+  Case::Bindings Bindings;
+  do {
+    if (!Bindings.empty()) {
+      ConsumeToken();
+    }
+    std::string Selector, VarName;
+    if (Tok.is(tok::numeric_constant)) {
+      Selector = ".f" + str::from(std::atoi(tokenText(Tok).c_str()));
+      ConsumeToken();
+      ExpectTokenKind(tok::colon);
+      VarName = ConsumeIdentifier();
+    } else {
+      Selector = VarName = ConsumeIdentifier();
+      if (Tok.is(tok::colon)) {
+        ConsumeToken();
+        VarName = ConsumeIdentifier();
+      }
+    }
     ExpectTokenKind(tok::equal);
-    auto T2 = ParseType();
-    return std::make_shared<Constraint>(
-        RecordDeconstructor::constraintName(),
-        list(tlong(0), tlong(1), T2, freshTypeVar(), T0, T1));
+    Bindings.push_back(Case::Binding(Selector, VarName, ParseExpression()));
+  } while (Tok.is(tok::comma));
+  ExpectTokenKind(tok::pipe);
+
+  if (Tok.is(tok::kw_default)) {
+    ConsumeToken();
+    ExprPtr Default = ParseExpression();
+    return ExprPtr(new Case(E, Bindings, Default, LexicallyAnnotated::make(Begin, PrevEnd)));
   }
+  return ExprPtr(new Case(E, Bindings, LexicallyAnnotated::make(Begin, PrevEnd)));
 }
 
-/// class-definition:
-///    "class" constraints "=>" id names
-///    "class" constraints "=>" id names "|" fundeps
-///    "class" constraints "=>" id names "|" fundeps "where" class_members
-///    "class" constraints "=>" id names where class_members
-///    "class" id names
-///    "class" id names "|" fundeps
-///    "class" id names "|" fundeps "where" class_members
-///    "class" id names "where" class_members
-auto Parser::ParseClassDef() -> bool {
-  Parser::ConsumeToken(); // consume class keyword
+/// record:
+///     "{" [recfieldname "=" l0expr ("," recfieldname "=" l0expr)*] "}"
+ExprPtr Parser::ParseRecordExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::l_brace);
+
+  MkRecord::FieldDefs Fields;
+  if (Tok.isNot(tok::r_brace)) {
+    do {
+      if (!Fields.empty()) {
+        ConsumeToken();
+      }
+      std::string Name = ParseRecordFieldName();
+      ExpectTokenKind(tok::equal);
+      Fields.push_back(MkRecord::FieldDef(Name, ParseExpression()));
+    } while (Tok.is(tok::comma));
+  }
+  ExpectTokenKind(tok::r_brace);
 
-  auto ParseTypeConstraints = [this]() {
-    Parser::ConsumeToken(); // consume l_paren
+  LexicalAnnotation La = LexicallyAnnotated::make(Begin, PrevEnd);
+  if (Fields.empty()) {
+    return ExprPtr(new Unit(La));
+  }
+  return ExprPtr(new MkRecord(Fields, La));
+}
 
-    // tpred ["," tpred]*
-    Parser::ParseTypePredicate();
-    while (Tok.is(tok::colon)) {
-      Parser::ConsumeToken();
-      Parser::ParseTypePredicate();
+/// paren-expr:
+///     "(" cargs ")"
+///   | "(" ("++" | "+" | "-" | "*" | "/" | "%" | "~" | "===" | "==" | "!="
+///         | "<" | ">" | ">=" | "<=" | "and" | "or" | "in" | "!") ")"
+ExprPtr Parser::ParseParenExpr() {
+  Pos Begin = TokBegin();
+  ExpectTokenKind(tok::l_paren);
+
+  // escapes for infix functions
+  if (PeekKind(1) == tok::r_paren) {
+    const char *Op = nullptr;
+    switch (Tok.getKind()) {
+    case tok::plusplus:        Op = "append"; break;
+    case tok::plus:            Op = "+"; break;
+    case tok::minus:           Op = "-"; break;
+    case tok::star:            Op = "*"; break;
+    case tok::slash:           Op = "/"; break;
+    case tok::percent:         Op = "%"; break;
+    case tok::tilde:           Op = "~"; break;
+    case tok::equalequalequal: Op = "==="; break;
+    case tok::equalequal:      Op = "=="; break;
+    case tok::notequal:        Op = "!="; break;
+    case tok::less:            Op = "<"; break;
+    case tok::greater:         Op = ">"; break;
+    case tok::greaterequal:    Op = ">="; break;
+    case tok::lessequal:       Op = "<="; break;
+    case tok::kw_and:          Op = "and"; break;
+    case tok::kw_or:           Op = "or"; break;
+    case tok::kw_in:           Op = "in"; break;
+    case tok::tnot:
+    case tok::kw_not:          Op = "not"; break;
+    default: break;
     }
+    if (Op) {
+      LexicalAnnotation La = TokAnnotation();
+      ConsumeToken();
+      ConsumeToken();
+      return ExprPtr(new Var(Op, La));
+    }
+  }
 
-    return;
-  };
-  auto ParseFunctionalDependencies = [this]() {};
-  auto ParseClassMembers = [this]() {};
+  // unit values, nested terms, and tuples
+  Exprs Es = ParseCallArgs(tok::r_paren);
+  return ExprPtr(pickNestedExp(Es, LexicallyAnnotated::make(Begin, PrevEnd)));
+}
 
-  if (Tok.getKind() == tok::l_paren) {
-    ParseTypeConstraints();
+/// patterns:
+///     pattern+
+Patterns Parser::ParsePatterns() {
+  Patterns Ps;
+  do {
+    Ps.push_back(ParsePattern());
+  } while (StartsPattern(Tok.getKind()));
+  return Ps;
+}
 
-    if (Tok.isNot(tok::doublearrow)) {
+/// patternseq:
+///     [pattern ("," pattern)*]
+Patterns Parser::ParsePatternSequence(tok::TokenKind ClosingTok) {
+  Patterns Ps;
+  if (Tok.isNot(ClosingTok)) {
+    Ps.push_back(ParsePattern());
+    while (Tok.is(tok::comma)) {
+      ConsumeToken();
+      Ps.push_back(ParsePattern());
     }
-    Parser::ConsumeToken();
   }
+  ExpectTokenKind(ClosingTok);
+  return Ps;
+}
 
-  // class identifier
-  if (Tok.isNot(tok::identifier)) {
+/// record-pattern-fields:
+///         record-pattern-field ("," record-pattern-field)*
+/// record-pattern-field:
+///         id "=" pattern
+MatchRecord::Fields Parser::ParseRecordPatternFields(tok::TokenKind ClosingTok) {
+  MatchRecord::Fields Fields;
+  do {
+    if (!Fields.empty()) {
+      ConsumeToken();
+    }
+    std::string Id = ConsumeIdentifier();
+    ExpectTokenKind(tok::equal);
+    Fields.push_back(MatchRecord::Field(Id, ParsePattern()));
+  } while (Tok.is(tok::comma));
+  ExpectTokenKind(ClosingTok);
+  return Fields;
+}
+
+/// refutable-pattern:
+///             "boolV"
+///           | "charV"
+///           | "byteV"
+///           | "shortV"
+///           | "intV"
+///           | "longV"
+///           | "doubleV"
+///           | "bytesV"
+///           | "stringV"
+///           | tsseq
+///           | "timeV"
+///           | "dateTimeV"
+///           | "regexV"
+///           | "[" patternseq "]"
+///           | "|" id "|"
+///           | "|" id "=" pattern "|"
+///           | "|" "intV" "=" pattern "|"
+///           | "(" patternseq ")"
+///           | "{" record-pattern-fields "}"
+///           | id
+PatternPtr Parser::ParsePattern() {
+  Pos Begin = TokBegin();
+  LexicalAnnotation La = TokAnnotation();
+  auto literal = [&](Primitive *P) {
+    ConsumeToken();
+    return PatternPtr(new MatchLiteral(PrimitivePtr(P), La));
+  };
+
+  switch (Tok.getKind()) {
+  case tok::kw_true:
+  case tok::kw_false:
+    return literal(new Bool(Tok.is(tok::kw_true), La));
+  case tok::char_constant:
+    return literal(new Char(str::readCharDef(tokenText(Tok)), La));
+  case tok::byte_constant:
+    return literal(new Byte(str::dehex(tokenText(Tok)), La));
+  case tok::short_constant:
+  case tok::numeric_constant:
+  case tok::long_constant:
+  case tok::double_constant: {
+    ExprPtr E = ParseNumericConstant();
+    return PatternPtr(new MatchLiteral(std::dynamic_pointer_cast<Primitive>(E), La));
+  }
+  case tok::bytes_literal: {
+    std::vector<unsigned char> Bs = str::dehexs(tokenText(Tok));
+    ConsumeToken();
+    return PatternPtr(mkpatarray(Bs, La));
   }
-  Parser::ConsumeToken();
+  case tok::string_literal: {
+    std::string S = str::unescape(str::trimq(tokenText(Tok)));
+    ConsumeToken();
+    return PatternPtr(mkpatarray(S, La));
+  }
+  case tok::timespan_literal: {
+    str::seq Ts;
+    while (Tok.is(tok::timespan_literal)) {
+      Ts.push_back(tokenText(Tok));
+      ConsumeToken();
+    }
+    LexicalAnnotation TLa = LexicallyAnnotated::make(Begin, PrevEnd);
+    return PatternPtr(new MatchLiteral(mkTimespanPrim(Ts, TLa), mkTimespanExpr(Ts, TLa), TLa));
+  }
+  case tok::time_literal: {
+    std::string T = tokenText(Tok);
+    ConsumeToken();
+    return PatternPtr(new MatchLiteral(mkTimePrim(T, La), mkTimeExpr(T, La), La));
+  }
+  case tok::datetime_literal: {
+    std::string T = tokenText(Tok);
+    ConsumeToken();
+    return PatternPtr(new MatchLiteral(mkDateTimePrim(T, La), mkDateTimeExpr(T, La), La));
+  }
+  case tok::regex_literal: {
+    llvm::StringRef RE = Tok.getLiteralData();
+    std::string R = RE.substr(1, RE.size() - 2).str();
+    ConsumeToken();
+    return PatternPtr(new MatchRegex(R, La));
+  }
+  case tok::l_square: {
+    ConsumeToken();
+    Patterns Ps = ParsePatternSequence(tok::r_square);
+    return PatternPtr(new MatchArray(Ps, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  case tok::pipe: {
+    ConsumeToken();
+    std::string Label;
+    if (Tok.is(tok::numeric_constant)) {
+      Label = ".f" + str::from(std::atoi(tokenText(Tok).c_str()));
+      ConsumeToken();
+      ExpectTokenKind(tok::equal);
+    } else {
+      LexicalAnnotation LabelLa = TokAnnotation();
+      Label = ConsumeIdentifier();
+      if (Tok.is(tok::pipe)) {
+        ConsumeToken();
+        return PatternPtr(new MatchVariant(Label, PatternPtr(new MatchLiteral(PrimitivePtr(new Unit(LabelLa)), LabelLa)),
+                                           LexicallyAnnotated::make(Begin, PrevEnd)));
+      }
+      ExpectTokenKind(tok::equal);
+    }
+    PatternPtr P = ParsePattern();
+    ExpectTokenKind(tok::pipe);
+    return PatternPtr(new MatchVariant(Label, P, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  case tok::l_paren: {
+    ConsumeToken();
+    Patterns Ps = ParsePatternSequence(tok::r_paren);
+    return PatternPtr(pickNestedPat(Ps, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  case tok::l_brace: {
+    ConsumeToken();
+    MatchRecord::Fields Fs = ParseRecordPatternFields(tok::r_brace);
+    return PatternPtr(new MatchRecord(Fs, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  case tok::identifier: {
+    std::string Id = ConsumeIdentifier();
+    return PatternPtr(patVarCtorFn(Id, La));
+  }
+  default:
+    Unexpected("pattern");
+  }
+}
 
-  while (Tok.getKind() == tok::identifier) {
+/// irrefutable-pattern:
+///             id
+///           | "(" patternseq ")"
+///           | "{" record-pattern-fields "}"
+PatternPtr Parser::ParseIrrefutablePattern() {
+  Pos Begin = TokBegin();
+  if (Tok.is(tok::identifier)) {
+    LexicalAnnotation La = TokAnnotation();
+    return PatternPtr(new MatchAny(ConsumeIdentifier(), La));
+  } else if (Tok.is(tok::l_paren)) {
+    ConsumeToken();
+    Patterns Ps = ParsePatternSequence(tok::r_paren);
+    return PatternPtr(pickNestedPat(Ps, LexicallyAnnotated::make(Begin, PrevEnd)));
+  } else if (Tok.is(tok::l_brace)) {
+    ConsumeToken();
+    MatchRecord::Fields Fs = ParseRecordPatternFields(tok::r_brace);
+    return PatternPtr(new MatchRecord(Fs, LexicallyAnnotated::make(Begin, PrevEnd)));
+  }
+  Unexpected("irrefutable pattern");
+}
+
+/// qtype:
+///     constraints "=>" l0mtype
+///   | l0mtype
+QualTypePtr Parser::ParseQualType() {
+  if (Tok.is(tok::l_paren) && IsFollowedAfterParens(tok::doublearrow)) {
+    Constraints Cs = ParseConstraints();
+    ExpectTokenKind(tok::doublearrow);
+    return QualTypePtr(new QualType(Cs, ParseType()));
+  }
+  return QualTypePtr(new QualType(Constraints(), ParseType()));
+}
+
+/// constraints:
+///     "(" tpred ("," tpred)* ")"
+Constraints Parser::ParseConstraints() {
+  Constraints Cs;
+  ExpectTokenKind(tok::l_paren);
+  Cs.push_back(ParseTypePredicate());
+  while (Tok.is(tok::comma)) {
+    ConsumeToken();
+    Cs.push_back(ParseTypePredicate());
+  }
+  ExpectTokenKind(tok::r_paren);
+  return Cs;
+}
 
-    Parser::ConsumeToken();
+/// tpred:
+///     id l1mtype+
+///   | l1mtype "==" l1mtype
+///   | l1mtype "!=" l1mtype
+///   | l1mtype "~" l1mtype
+///   | l1mtype "=" "{" [id ":"] l1mtype "*" l1mtype "}"
+///   | l1mtype "=" "(" l1mtype "*" l1mtype ")"
+///   | "{" [id ":"] l1mtype "*" l1mtype "}" "=" l1mtype
+///   | "(" l1mtype "*" l1mtype ")" "=" l1mtype
+///   | l1mtype "." recfieldname ("::" | "<-") l1mtype
+///   | l1mtype "/" l1mtype ("::" | "<-") l1mtype
+///   | l1mtype "=" "|" [id ":"] l1mtype "+" l1mtype "|"
+///   | "|" [id ":"] l1mtype "+" l1mtype "|" "=" l1mtype
+///   | "|" id ":" l0mtype "|" "::" l1mtype
+///   | "|" l1mtype "/" l0mtype "|" "::" l1mtype
+///   | l1mtype "++" l1mtype "=" l1mtype
+ConstraintPtr Parser::ParseTypePredicate() {
+  auto recordDeconstructor = [](long Inject, long IsTuple, const MonoTypePtr &R, const MonoTypePtr &Label,
+                                const MonoTypePtr &H, const MonoTypePtr &T) {
+    return ConstraintPtr(new Constraint(RecordDeconstructor::constraintName(),
+                                        list(tlong(Inject), tlong(IsTuple), R, Label, H, T)));
+  };
+  auto variantDeconstructor = [](long Inject, const MonoTypePtr &V, const MonoTypePtr &Label,
+                                 const MonoTypePtr &H, const MonoTypePtr &T) {
+    return ConstraintPtr(new Constraint(VariantDeconstructor::constraintName(),
+                                        list(tlong(Inject), V, Label, H, T)));
+  };
+
+  // type class constraints
+  if (Tok.is(tok::identifier) && StartsType(PeekKind(1))) {
+    std::string Name = ConsumeIdentifier();
+    MonoTypes Args;
+    do {
+      Args.push_back(ParseL1Type());
+    } while (StartsType(Tok.getKind()));
+    return ConstraintPtr(new Constraint(Name, Args));
   }
 
-  if (Tok.getKind() == tok::pipe) {
-    Parser::ConsumeToken();
-    ParseFunctionalDependencies();
+  // the first type may be the start of a record, tuple or variant deconstruction
+  Pos Begin = TokBegin();
+  MonoTypePtr L;
+  if (Tok.is(tok::l_brace)) {
+    ConsumeToken();
+    std::string FieldName;
+    if (Tok.is(tok::identifier) && PeekKind(1) == tok::colon) {
+      FieldName = ConsumeIdentifier();
+      ConsumeToken();
+    }
+    MonoTypes Args;
+    MonoTypePtr H = ParseL1Type(FieldName.empty() ? nullptr : &Args);
+    if (Tok.is(tok::star) && H) {
+      ConsumeToken();
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::r_brace);
+      ExpectTokenKind(tok::equal);
+      MonoTypePtr R = ParseL1Type();
+      return recordDeconstructor(0, 0, R, FieldName.empty() ? freshTypeVar() : TVar::make(FieldName), H, T);
+    } else if (FieldName.empty()) {
+      Unexpected("'*'");
+    }
+    L = ParseTypeSuffix(Record::make(ParseRecordTypeRest(list(Record::Member(FieldName, ParseTypeFrom(H, Args))))));
+  } else if (Tok.is(tok::l_paren) && !(PeekKind(1) == tok::r_paren || (PeekKind(1) == tok::arrow && PeekKind(2) == tok::r_paren))) {
+    ConsumeToken();
+    MonoTypes Args;
+    MonoTypePtr H = ParseL1Type(&Args);
+    if (Tok.is(tok::star) && H) {
+      ConsumeToken();
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::r_paren);
+      ExpectTokenKind(tok::equal);
+      MonoTypePtr R = ParseL1Type();
+      return recordDeconstructor(0, 1, R, freshTypeVar(), H, T);
+    }
+    L = ParseTypeSuffix(ParseParenTypeRest(ParseTypeFrom(H, Args), Begin));
+  } else if (Tok.is(tok::pipe) && PeekKind(1) == tok::identifier && PeekKind(2) == tok::colon) {
+    ConsumeToken();
+    std::string Ctor = ConsumeIdentifier();
+    ConsumeToken();
+    MonoTypes Args;
+    MonoTypePtr H = ParseL1Type(&Args);
+    if (Tok.is(tok::plus) && H) {
+      ConsumeToken();
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::pipe);
+      ExpectTokenKind(tok::equal);
+      MonoTypePtr V = ParseL1Type();
+      return variantDeconstructor(0, V, TVar::make(Ctor), H, T);
+    }
+    MonoTypePtr CT = ParseTypeFrom(H, Args);
+    if (Tok.is(tok::pipe)) {
+      ConsumeToken();
+      ExpectTokenKind(tok::coloncolon);
+      return ConstraintPtr(new Constraint(CtorVerifier::constraintName(), list(ParseL1Type(), TString::make(Ctor), CT)));
+    }
+    L = ParseTypeSuffix(makeVarType(ParseVariantTypeRest(list(Variant::Member(Ctor, CT, 0)))));
+  } else if (Tok.is(tok::pipe) && !(PeekKind(1) == tok::identifier && (PeekKind(2) == tok::pipe || PeekKind(2) == tok::comma))) {
+    ConsumeToken();
+    MonoTypePtr H = ParseL1Type();
+    if (Tok.is(tok::plus)) {
+      ConsumeToken();
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::pipe);
+      ExpectTokenKind(tok::equal);
+      MonoTypePtr V = ParseL1Type();
+      return variantDeconstructor(0, V, freshTypeVar(), H, T);
+    }
+    ExpectTokenKind(tok::slash);
+    MonoTypePtr CT = ParseType();
+    ExpectTokenKind(tok::pipe);
+    ExpectTokenKind(tok::coloncolon);
+    return ConstraintPtr(new Constraint(CtorVerifier::constraintName(), list(ParseL1Type(), H, CT)));
+  } else {
+    L = ParseL1Type();
+  }
 
-    if (Tok.getKind() == tok::kw_where) {
-      ParseClassMembers();
+  switch (Tok.getKind()) {
+  case tok::equalequal:
+    ConsumeToken();
+    return ConstraintPtr(new Constraint(EqualTypes::constraintName(), list(L, ParseL1Type())));
+  case tok::notequal:
+    ConsumeToken();
+    return ConstraintPtr(new Constraint(NotEqualTypes::constraintName(), list(L, ParseL1Type())));
+  case tok::tilde:
+    ConsumeToken();
+    return ConstraintPtr(new Constraint(FixIsoRecur::constraintName(), list(L, ParseL1Type())));
+  case tok::equal:
+    ConsumeToken();
+    if (Tok.is(tok::l_brace)) {
+      ConsumeToken();
+      std::string FieldName;
+      if (Tok.is(tok::identifier) && PeekKind(1) == tok::colon) {
+        FieldName = ConsumeIdentifier();
+        ConsumeToken();
+      }
+      MonoTypePtr H = ParseL1Type();
+      ExpectTokenKind(tok::star);
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::r_brace);
+      return recordDeconstructor(1, 0, L, FieldName.empty() ? freshTypeVar() : TVar::make(FieldName), H, T);
+    } else if (Tok.is(tok::l_paren)) {
+      ConsumeToken();
+      MonoTypePtr H = ParseL1Type();
+      ExpectTokenKind(tok::star);
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::r_paren);
+      return recordDeconstructor(1, 1, L, freshTypeVar(), H, T);
+    } else if (Tok.is(tok::pipe)) {
+      ConsumeToken();
+      std::string Ctor;
+      if (Tok.is(tok::identifier) && PeekKind(1) == tok::colon) {
+        Ctor = ConsumeIdentifier();
+        ConsumeToken();
+      }
+      MonoTypePtr H = ParseL1Type();
+      ExpectTokenKind(tok::plus);
+      MonoTypePtr T = ParseL1Type();
+      ExpectTokenKind(tok::pipe);
+      return variantDeconstructor(1, L, Ctor.empty() ? freshTypeVar() : TVar::make(Ctor), H, T);
     }
+    Unexpected("'{', '(' or '|'");
+  case tok::period: {
+    ConsumeToken();
+    std::string Field = ParseRecordFieldName();
+    HasField::Direction D = Tok.is(tok::assign) ? HasField::Write : HasField::Read;
+    if (Tok.isOneOf(tok::coloncolon, tok::assign)) {
+      ConsumeToken();
+    } else {
+      Unexpected("'::' or '<-'");
+    }
+    return ConstraintPtr(HasField::newConstraint(D, L, TString::make(Field), ParseL1Type()));
   }
+  case tok::slash: {
+    ConsumeToken();
+    MonoTypePtr F = ParseL1Type();
+    HasField::Direction D = Tok.is(tok::assign) ? HasField::Write : HasField::Read;
+    if (Tok.isOneOf(tok::coloncolon, tok::assign)) {
+      ConsumeToken();
+    } else {
+      Unexpected("'::' or '<-'");
+    }
+    return ConstraintPtr(HasField::newConstraint(D, L, F, ParseL1Type()));
+  }
+  case tok::plusplus: {
+    ConsumeToken();
+    MonoTypePtr R = ParseL1Type();
+    ExpectTokenKind(tok::equal);
+    return ConstraintPtr(new Constraint(AppendsToUnqualifier::constraintName(), list(L, R, ParseL1Type())));
+  }
+  default:
+    Unexpected("type constraint");
+  }
+}
 
-  return false;
+/// l0mtype:
+///     l0mtargl "->" l1mtype
+///   | l1mtype ("*" l1mtype)*
+///   | l1mtype ("+" l1mtype)+
+/// l0mtargl:
+///     l1mtype
+///   | "(" l0mtype "," l0mtype ("," l0mtype)* ")"
+MonoTypePtr Parser::ParseType() {
+  MonoTypes Args;
+  MonoTypePtr First = ParseL1Type(&Args);
+  return ParseTypeFrom(First, Args);
 }
 
-/// module-definition:
-///         import-definition
-///       | type-definition
-///       | data-definition
-///       | instance-definition
-///       | class-definition
-bool Parser::ParseModuleDefs() {
-  // Prime Lexer
-  Parser::ConsumeToken();
-  hobbes::tok::TokenKind kind = Tok.getKind();
-  if (kind == tok::kw_import) {
-    Parser::ParseImportStatement();
-  } else if (kind == tok::kw_type) {
-    // ParseTypeDef();
-  } else if (kind == tok::kw_data) {
-    // ParseDataDef();
-  } else if (kind == tok::kw_class) {
-    // ParseClassDef();
-  } else if (kind == tok::kw_instance) {
-    // ParseInstanceDef();
-  } else if (kind == tok::identifier) {
-    std::vector<Token> idents;
-    while (Tok.getKind() == tok::identifier) {
-      idents.push_back(Tok);
-      Parser::ConsumeToken();
+/// Finish reading an l0mtype that starts with an l1mtype (or with a list of
+/// function arguments, if the l1mtype is null)
+MonoTypePtr Parser::ParseTypeFrom(const MonoTypePtr &First, const MonoTypes &ArgList) {
+  if (!First) {
+    ExpectTokenKind(tok::arrow);
+    return Func::make(tuple(ArgList), ParseL1Type());
+  }
+
+  if (Tok.is(tok::arrow)) {
+    ConsumeToken();
+    return Func::make(tuple(list(First)), ParseL1Type());
+  } else if (Tok.is(tok::star)) {
+    MonoTypes Ts = list(First);
+    while (Tok.is(tok::star)) {
+      ConsumeToken();
+      Ts.push_back(ParseL1Type());
     }
-    if (Tok.getKind() == tok::equal) {
-      // Lexer.LexToken();
-      // ParseL0Expression();
-    } else if (idents.size() == 1) {
-      // ParseL5Expression();
+    return makeTupleType(Ts);
+  } else if (Tok.is(tok::plus)) {
+    MonoTypes Ts = list(First);
+    while (Tok.is(tok::plus)) {
+      ConsumeToken();
+      Ts.push_back(ParseL1Type());
+    }
+    return makeSumType(Ts);
+  }
+  return makeTupleType(list(First));
+}
+
+/// l1mtype:
+///     id
+///   | "<" cppid ">"
+///   | "[" "]"
+///   | "[" l0mtype+ "]"
+///   | "[" ":" l0mtype "|" (id | "intV") ":" "]"
+///   | "(" "->" ")"
+///   | "(" l0mtype+ ")"
+///   | "(" ")"
+///   | "{" id ":" l0mtype ("," id ":" l0mtype)* "}"
+///   | "|" id [":" l0mtype] ("," id [":" l0mtype])* "|"
+///   | "intV"
+///   | "boolV"
+///   | "exists" id "." l1mtype
+///   | "^" id "." l1mtype
+///   | "stringV"
+///   | "`" l0expr "`"
+///   | l1mtype "@" (l1mtype | "?")
+///
+/// If ArgList is given, a parenthesized list of function arguments is read
+/// into it (and null is returned).
+MonoTypePtr Parser::ParseL1Type(MonoTypes *ArgList) {
+  Pos Begin = TokBegin();
+  MonoTypePtr T;
+  switch (Tok.getKind()) {
+  case tok::identifier:
+    T = monoTypeByName(C, ConsumeIdentifier());
+    break;
+  case tok::less: {
+    ConsumeToken();
+    std::string Name = ParseQualifiedId();
+    ExpectTokenKind(tok::greater);
+    T = OpaquePtr::make(str::replace<char>(Name, ".", "::"), 0, false);
+    break;
+  }
+  case tok::l_square:
+    ConsumeToken();
+    if (Tok.is(tok::r_square)) {
+      ConsumeToken();
+      T = Prim::make("[]");
+    } else if (Tok.is(tok::colon)) {
+      ConsumeToken();
+      MonoTypePtr ET = ParseType();
+      ExpectTokenKind(tok::pipe);
+      MonoTypePtr Len;
+      if (Tok.is(tok::numeric_constant)) {
+        Len = TLong::make(std::atoi(tokenText(Tok).c_str()));
+        ConsumeToken();
+      } else {
+        Len = TVar::make(ConsumeIdentifier());
+      }
+      ExpectTokenKind(tok::colon);
+      ExpectTokenKind(tok::r_square);
+      T = FixedArray::make(ET, Len);
+    } else {
+      Pos TBegin = TokBegin();
+      MonoTypes Ts;
+      do {
+        Ts.push_back(ParseType());
+      } while (Tok.isNot(tok::r_square) && Tok.isNot(tok::eof));
+      LexicalAnnotation La = LexicallyAnnotated::make(TBegin, PrevEnd);
+      ExpectTokenKind(tok::r_square);
+      try {
+        T = Array::make(C->replaceTypeAliases(accumTApp(Ts)));
+      } catch (std::exception &ex) {
+        throw annotated_error(La, ex.what());
+      }
+    }
+    break;
+  case tok::l_paren:
+    if (PeekKind(1) == tok::r_paren) {
+      ConsumeToken();
+      ConsumeToken();
+      T = Prim::make("unit");
+    } else if (PeekKind(1) == tok::arrow && PeekKind(2) == tok::r_paren) {
+      ConsumeToken();
+      ConsumeToken();
+      ConsumeToken();
+      T = Prim::make("->");
     } else {
+      ConsumeToken();
+      MonoTypePtr First = ParseType();
+      if (Tok.is(tok::comma) && ArgList) {
+        // function arguments
+        MonoTypes Args = list(First);
+        while (Tok.is(tok::comma)) {
+          ConsumeToken();
+          Args.push_back(ParseType());
+        }
+        ExpectTokenKind(tok::r_paren);
+        *ArgList = Args;
+        return MonoTypePtr();
+      }
+      T = ParseParenTypeRest(First, Begin);
     }
+    break;
+  case tok::l_brace: {
+    ConsumeToken();
+    std::string Name = ConsumeIdentifier();
+    ExpectTokenKind(tok::colon);
+    T = Record::make(ParseRecordTypeRest(list(Record::Member(Name, ParseType()))));
+    break;
+  }
+  case tok::pipe: {
+    ConsumeToken();
+    std::string Name = ConsumeIdentifier();
+    MonoTypePtr CT = Prim::make("unit");
+    if (Tok.is(tok::colon)) {
+      ConsumeToken();
+      CT = ParseType();
+    }
+    T = makeVarType(ParseVariantTypeRest(list(Variant::Member(Name, CT, 0))));
+    break;
+  }
+  case tok::numeric_constant: {
+    int N = std::atoi(tokenText(Tok).c_str());
+    ConsumeToken();
+    T = (N == 0) ? Prim::make("void") : TLong::make(N);
+    break;
+  }
+  case tok::kw_true:
+  case tok::kw_false:
+    T = TLong::make(Tok.is(tok::kw_true) ? 1 : 0);
+    ConsumeToken();
+    break;
+  case tok::kw_exists:
+  case tok::caret: {
+    bool IsExists = Tok.is(tok::kw_exists);
+    ConsumeToken();
+    std::string Name = ConsumeIdentifier();
+    ExpectTokenKind(tok::period);
+    MonoTypePtr B = ParseL1Type();
+    return IsExists ? Exists::make(Name, B) : Recursive::make(Name, B);
+  }
+  case tok::string_literal:
+    T = TString::make(str::unescape(str::trimq(tokenText(Tok))));
+    ConsumeToken();
+    break;
+  case tok::equote: {
+    ConsumeToken();
+    ExprPtr E = ParseExpression();
+    ExpectTokenKind(tok::equote);
+    T = TApp::make(primty("quote"), list(texpr(E)));
+    break;
+  }
+  default:
+    Unexpected("type");
+  }
+  return ParseTypeSuffix(T);
+}
+
+/// Read any file references that follow a type (as in 't@f' or 't@?')
+MonoTypePtr Parser::ParseTypeSuffix(MonoTypePtr T) {
+  while (Tok.is(tok::at)) {
+    ConsumeToken();
+    if (Tok.is(tok::question)) {
+      ConsumeToken();
+      T = TApp::make(Prim::make("fileref"), list(T));
+    } else {
+      T = TApp::make(Prim::make("fileref"), list(T, ParseL1Type()));
+    }
+  }
+  return T;
+}
+
+/// Finish reading a parenthesized type application (after its first type)
+MonoTypePtr Parser::ParseParenTypeRest(const MonoTypePtr &First, const Pos &Begin) {
+  Pos TBegin(Begin.first, Begin.second + 1);
+  MonoTypes Ts = list(First);
+  while (Tok.isNot(tok::r_paren) && Tok.isNot(tok::eof)) {
+    Ts.push_back(ParseType());
+  }
+  LexicalAnnotation La = LexicallyAnnotated::make(TBegin, PrevEnd);
+  ExpectTokenKind(tok::r_paren);
+  try {
+    return clone(C->replaceTypeAliases(accumTApp(Ts)));
+  } catch (std::exception &ex) {
+    throw annotated_error(La, ex.what());
+  }
+}
+
+/// Finish reading record type members (after the first member)
+Record::Members Parser::ParseRecordTypeRest(Record::Members Ms) {
+  while (Tok.is(tok::comma)) {
+    ConsumeToken();
+    std::string Name = ConsumeIdentifier();
+    ExpectTokenKind(tok::colon);
+    Ms.push_back(Record::Member(Name, ParseType()));
   }
+  ExpectTokenKind(tok::r_brace);
+  return Ms;
 }
 
-bool Parser::ParseModule() {
-  Parser::ConsumeToken();
-  if (Tok.getKind() == tok::kw_module) {
-    Parser::ConsumeToken();
-    if (Tok.getKind() == tok::identifier) {
+/// Finish reading variant type members (after the first member)
+Variant::Members Parser::ParseVariantTypeRest(Variant::Members Ms) {
+  while (Tok.is(tok::comma)) {
+    ConsumeToken();
+    std::string Name = ConsumeIdentifier();
+    MonoTypePtr CT = Prim::make("unit");
+    if (Tok.is(tok::colon)) {
+      ConsumeToken();
+      CT = ParseType();
     }
-    Parser::ConsumeToken();
-    if (Tok.getKind() == tok::kw_where) {
+    Ms.push_back(Variant::Member(Name, CT, 0));
+  }
+  ExpectTokenKind(tok::pipe);
+  return Ms;
+}
+
+/*
+ * entry points
+ */
+
+// annotations made while parsing refer back to the text being parsed
+struct ParseContext {
+  ParseContext(bool IsFile, const std::string &X) {
+    if (IsFile) {
+      LexicallyAnnotated::pushFileContext(X);
+    } else {
+      LexicallyAnnotated::pushLiteralContext(X);
     }
-  } else {
   }
+  ~ParseContext() { LexicallyAnnotated::popContext(); }
+};
+
+template <typename T, typename F>
+static T runParser(cc *C, bool IsFile, const std::string &Desc, llvm::StringRef Text,
+                   const std::string &ModulePath, F P) {
+  ParseContext PC(IsFile, Desc);
+  Lexer Lex(Text.begin(), Text.begin(), Text.end());
+  Parser Parse(C, Lex, ModulePath);
+  try {
+    return P(Parse);
+  } catch (annotated_error &) {
+    throw;
+  } catch (std::exception &ex) {
+    // errors raised while defining types (or anything else outside of the parser) refer to the current token
+    throw annotated_error(Parse.CurrentAnnotation(), ex.what());
+  }
+}
+
+ModulePtr parseModuleFile(cc *C, const std::string &FileName) {
+  std::ifstream F(FileName);
+  if (!F) {
+    throw std::runtime_error("Failed to open file for reading, '" + FileName + "'");
+  }
+  std::string Text((std::istreambuf_iterator<char>(F)), std::istreambuf_iterator<char>());
+
+  return runParser<ModulePtr>(C, true, FileName, Text, str::rsplit(FileName, "/").first,
+                              [](Parser &P) { return P.ParseModule(); });
+}
+
+ModulePtr parseModule(cc *C, const std::string &Text) {
+  return runParser<ModulePtr>(C, false, Text, Text.c_str(), "",
+                              [](Parser &P) { return P.ParseModule(); });
+}
+
+ExprDefn parseExprDefn(cc *C, const std::string &Text) {
+  return runParser<ExprDefn>(C, false, Text, Text.c_str(), "",
+                             [](Parser &P) { return P.ParseExprDefn(); });
+}
 
-  Parser::ParseModuleDefs();
+ExprPtr parseExpr(cc *C, const std::string &Text) {
+  return runParser<ExprPtr>(C, false, Text, Text.c_str(), "",
+                            [](Parser &P) { return P.ParseExpr(); });
 }
 }
@@ -2,8 +2,30 @@
 
 namespace hobbes {
 namespace tok {
- std::string getTokenName(TokenKind t) {
-   return "";
- }
+static const char *const TokNames[] = {
+#define TOK(X) #X,
+#include "hobbes/Lex/TokenKinds.def"
+    nullptr};
+
+static const char *const TokSpellings[] = {
+#define TOK(X) nullptr,
+#define PUNCTUATOR(X, Y) Y,
+#define KEYWORD(X) #X,
+#include "hobbes/Lex/TokenKinds.def"
+    nullptr};
+
+std::string getTokenName(TokenKind t) {
+  if (t < 0 || t >= NUM_TOKENS) {
+    return "";
+  }
+  return TokNames[t];
+}
+
+const char *getTokenSpelling(TokenKind t) {
+  if (t < 0 || t >= NUM_TOKENS) {
+    return nullptr;
+  }
+  return TokSpellings[t];
+}
 }
 }
@@ -32,6 +32,7 @@ typedef struct YYLTYPE {
 #include <hobbes/parse/grammar.H>
 #include <hobbes/parse/lalr.H>
 #include <hobbes/read/pgen/hexpr.parse.H>
+#include <hobbes/read/terms.H>
 #include <string>
 #include <stdexcept>
 #include <vector>
@@ -39,9 +40,6 @@ typedef struct YYLTYPE {
 
 using namespace hobbes;
 
-typedef std::pair<PatternPtr, ExprPtr> LetBinding;
-typedef std::vector<LetBinding>        LetBindings;
-
 cc*         yyParseCC;
 Module*     yyParsedModule = 0;
 std::string yyParsedVar;
@@ -68,214 +66,11 @@ LexicalAnnotation m(const YYLTYPE& p0, const YYLTYPE& p1) {
   return LexicallyAnnotated::make(Pos(p0.first_line, p0.first_column), Pos(p1.last_line, p1.last_column));
 }
 
-MonoTypePtr forceMonotype(const QualTypePtr& qt, const LexicalAnnotation& la) {
-  MonoTypeUnifier u(yyParseCC->typeEnv());
-  Definitions ds;
-  while (refine(yyParseCC->typeEnv(), qt->constraints(), &u, &ds)) {
-    yyParseCC->drainUnqualifyDefs(ds);
-    ds.clear();
-  }
-  yyParseCC->drainUnqualifyDefs(ds);
-  ds.clear();
-
-  // make sure that the output type exists and is realizable
-  if (hobbes::satisfied(yyParseCC->typeEnv(), qt->constraints(), &ds)) {
-    yyParseCC->drainUnqualifyDefs(ds);
-    return u.substitute(qt->monoType());
-  } else {
-    throw annotated_error(la, "Cannot resolve qualifications in type");
-  }
-}
-
 #define TAPP0(fn,la)          new App(fn, list<ExprPtr>(), la)
 #define TAPP1(fn,x0,la)       new App(fn, list(ExprPtr(x0)), la)
 #define TAPP2(fn,x0,x1,la)    new App(fn, list(ExprPtr(x0),ExprPtr(x1)), la)
 #define TAPP3(fn,x0,x1,x2,la) new App(fn, list(ExprPtr(x0),ExprPtr(x1),ExprPtr(x2)), la)
 
-Expr* pickNestedExp(Exprs* exprs, const LexicalAnnotation& la) {
-  if (exprs->size() == 0) {
-    return new Unit(la);
-  } else if (exprs->size() == 1) {
-    return (*exprs)[0]->clone();
-  } else {
-    MkRecord::FieldDefs fds;
-    for (int i = 0; i < exprs->size(); ++i) {
-      fds.push_back(MkRecord::FieldDef(".f" + str::from(i), (*exprs)[i]));
-    }
-    return new MkRecord(fds, la);
-  }
-}
-
-Pattern* pickNestedPat(Patterns* pats, const LexicalAnnotation& la) {
-  if (pats->size() == 0) {
-    return new MatchLiteral(PrimitivePtr(new Unit(la)), la);
-  } else {
-    MatchRecord::Fields fds;
-    for (int i = 0; i < pats->size(); ++i) {
-      fds.push_back(MatchRecord::Field(".f" + str::from(i), (*pats)[i]));
-    }
-    return new MatchRecord(fds, la);
-  }
-}
-
-PatternRows normPatternRules(PatternRows rs, const LexicalAnnotation& la) {
-  if (rs.size() > 0 && !rs.back().result) {
-    throw annotated_error(la, "match table can't end with fall-through row");
-  }
-
-  for (size_t i = rs.size(); i > 0; --i) {
-    if (!rs[i-1].result) {
-      rs[i-1].result = rs[i].result;
-    }
-  }
-  return rs;
-}
-
-Expr* compileNestedLetMatch(const LetBindings& bs, const ExprPtr& e, const LexicalAnnotation& la) {
-  ExprPtr r = e;
-  for (LetBindings::const_reverse_iterator b = bs.rbegin(); b != bs.rend(); ++b) {
-    r = compileMatch(yyParseCC, list(b->second), list(PatternRow(list(b->first), r)), la);
-  }
-  return r->clone();
-}
-
-ExprPtr irpatFunc(const PatternPtr& pat, const ExprPtr& body, const LexicalAnnotation& la) {
-  return fn(str::strings(".arg"), compileMatch(yyParseCC, list(var(".arg", la)), list(PatternRow(list(pat), body)), la), la);
-}
-
-ExprPtr rpatFunc(const PatternPtr& pat, const ExprPtr& cond, const ExprPtr& body, const LexicalAnnotation& la) {
-  MonoTypePtr rty   = freshTypeVar();
-  MonoTypePtr mrty  = sumtype(primty("unit"), rty);
-  ExprPtr     fbody = assume(ExprPtr(new MkVariant(".f0", mktunit(la), la)), mrty, la);
-  ExprPtr     sbody = assume(ExprPtr(new MkVariant(".f1", body, la)), mrty, la);
-  PatternRow  pr    = cond ? PatternRow(list(pat), cond, sbody) : PatternRow(list(pat), sbody);
-
-  return fn(str::strings(".arg"), compileMatch(yyParseCC, list(var(".arg", la)), list(pr, PatternRow(list(PatternPtr(new MatchAny("_", la))), fbody)), la), la);
-}
-
-Expr* compileArrayComprehension(const ExprPtr& body, const PatternPtr& pat, const ExprPtr& arr, const LexicalAnnotation& la) {
-  if (refutable(pat)) {
-    return new App(var("ffilterMMap", la), list(rpatFunc(pat, ExprPtr(), body, la), arr), la);
-  } else {
-    return new App(var("fmap", la), list(irpatFunc(pat, body, la), arr), la);
-  }
-}
-
-Expr* compileArrayComprehension(const ExprPtr& body, const PatternPtr& pat, const ExprPtr& arr, const ExprPtr& cond, const LexicalAnnotation& la) {
-  if (refutable(pat)) {
-    return new App(var("ffilterMMap", la), list(rpatFunc(pat, cond, body, la), arr), la);
-  } else {
-    return new App(var("ffilterMap", la), list(irpatFunc(pat, cond, la), irpatFunc(pat, body, la), arr), la);
-  }
-}
-
-Expr* makeRefutablePatternFn(const Patterns& ps, const ExprPtr& e, const LexicalAnnotation& la) {
-  str::seq vns;
-  Exprs    vnes;
-  Patterns els;
-  for (size_t i = 0; i < ps.size(); ++i) {
-    std::string vname = ".arg" + str::from(i);
-    vns.push_back(vname);
-    vnes.push_back(isUnitPat(ps[i]) ? assume(var(vname, la), primty("unit"), la) : var(vname, la));
-    els.push_back(PatternPtr(new MatchAny("_", la)));
-  }
-  return
-    new Fn(vns,
-      compileMatch(yyParseCC, vnes, list(
-        PatternRow(ps,  justE(e, la)),
-        PatternRow(els, nothingE(la))
-      ), la),
-      la
-    );
-}
-
-Expr* makeIrrefutablePatternFn(const Patterns& ps, const ExprPtr& e, const LexicalAnnotation& la) {
-  str::seq vns;
-  Exprs    vnes;
-  for (size_t i = 0; i < ps.size(); ++i) {
-    std::string vname = ".arg" + str::from(i);
-    vns.push_back(vname);
-    vnes.push_back(isUnitPat(ps[i]) ? assume(var(vname, la), primty("unit"), la) : var(vname, la));
-  }
-  return new Fn(vns, compileMatch(yyParseCC, vnes, list(PatternRow(ps, e)), la), la);
-}
-
-Expr* makePatternFn(const Patterns& ps, const ExprPtr& e, const LexicalAnnotation& la) {
-  for (const auto p : ps) {
-    if (refutable(p)) {
-      return makeRefutablePatternFn(ps, e, la);
-    }
-  }
-  return makeIrrefutablePatternFn(ps, e, la);
-}
-
-Expr* makeProjSeq(Expr* rec, const str::seq& fields, const LexicalAnnotation& la) {
-  for (const auto& f : fields) {
-    rec = new Proj(ExprPtr(rec), f, la);
-  }
-  return rec;
-}
-
-MonoTypePtr monoTypeByName(const std::string& tn) {
-  if (isPrimName(tn) || yyParseCC->isTypeAliasName(tn)) {
-    return Prim::make(tn);
-  } else if (yyParseCC->isTypeName(tn)) {
-    return Prim::make(tn, yyParseCC->namedTypeRepresentation(tn));
-  } else {
-    return TVar::make(tn);
-  }
-}
-
-MonoTypePtr accumTApp(const MonoTypes& ts) {
-  if (ts.size() == 0) {
-    throw std::runtime_error("Internal parser error for type applications");
-  } else if (ts.size() == 1) {
-    return ts[0];
-  } else {
-    return MonoTypePtr(TApp::make(ts[0], drop(ts, 1)));
-  }
-}
-
-MonoTypePtr makeTupleType(const MonoTypes& mts) {
-  if (mts.size() == 1) {
-    return clone(mts[0]);
-  } else {
-    Record::Members tms;
-    for (unsigned int i = 0; i < mts.size(); ++i) {
-      tms.push_back(Record::Member(".f" + str::from(i), mts[i]));
-    }
-    return Record::make(tms);
-  }
-}
-
-MonoTypePtr makeSumType(const MonoTypes& mts) {
-  Variant::Members ms;
-  for (unsigned int i = 0; i < mts.size(); ++i) {
-    ms.push_back(Variant::Member(".f" + str::from(i), mts[i], i));
-  }
-  return Variant::make(ms);
-}
-
-MonoTypePtr makeRecType(const Record::Members& tms) {
-  return Record::make(tms);
-}
-
-MonoTypePtr makeVarType(const Variant::Members& vms) {
-  Variant::Members tvms = vms;
-  for (unsigned int i = 0; i < tvms.size(); ++i) {
-    tvms[i].id = i;
-  }
-  return Variant::make(tvms);
-}
-
-str::seq tupSectionFields(const std::string& x) {
-  str::seq r = str::csplit(x.substr(1), ".");
-  for (std::string& f : r) {
-    f = ".f" + f;
-  }
-  return r;
-}
-
 // override var and pat-var construction
 namespace hobbes {
 typedef Expr* (*VarCtorFn)(const std::string&, const LexicalAnnotation&);
@@ -542,8 +337,8 @@ def: importdef { $$ = $1; }
 importdef: "import" cppid { $$ = new MImport(yyModulePath, *$2, m(@1, @2)); }
 
 /* abbreviate type names */
-tydef: "type" nameseq "=" qtype { MTypeDef* td = new MTypeDef(MTypeDef::Transparent, hobbes::select(*$2, 0), hobbes::select(*$2, 1, (int)$2->size()), forceMonotype(QualTypePtr($4), m(@4)), m(@1, @4)); yyParseCC->defineTypeAlias(td->name(), td->arguments(), td->type()); $$ = td; }
-     | "data" nameseq "=" qtype { MTypeDef* td = new MTypeDef(MTypeDef::Opaque, hobbes::select(*$2, 0), hobbes::select(*$2, 1, (int)$2->size()), forceMonotype(QualTypePtr($4), m(@4)), m(@1, @4)); yyParseCC->defineNamedType(td->name(), td->arguments(), td->type()); $$ = td; }
+tydef: "type" nameseq "=" qtype { MTypeDef* td = new MTypeDef(MTypeDef::Transparent, hobbes::select(*$2, 0), hobbes::select(*$2, 1, (int)$2->size()), forceMonotype(yyParseCC, QualTypePtr($4), m(@4)), m(@1, @4)); yyParseCC->defineTypeAlias(td->name(), td->arguments(), td->type()); $$ = td; }
+     | "data" nameseq "=" qtype { MTypeDef* td = new MTypeDef(MTypeDef::Opaque, hobbes::select(*$2, 0), hobbes::select(*$2, 1, (int)$2->size()), forceMonotype(yyParseCC, QualTypePtr($4), m(@4)), m(@1, @4)); yyParseCC->defineNamedType(td->name(), td->arguments(), td->type()); $$ = td; }
 
 /* variable bindings by type and expression */
 vartybind: name "::" qtype { $$ = new MVarTypeDef(*$1, QualTypePtr($3), m(@1, @3)); }
@@ -620,7 +415,7 @@ types: l0mtype       { $$ = autorelease(new MonoTypes()); $$->push_back(*$1); }
      | types l0mtype { $$ = $1;                           $$->push_back(*$2); }
 
 /* expressions */
-l0expr: "\\" patterns "." l0expr { $$ = makePatternFn(*$2, ExprPtr($4), m(@1, @4)); }
+l0expr: "\\" patterns "." l0expr { $$ = makePatternFn(yyParseCC, *$2, ExprPtr($4), m(@1, @4)); }
       | "!" l1expr               { $$ = TAPP1(var("not",m(@1)), $2, m(@1,@2)); }
       | l0expr "and" l0expr      { $$ = TAPP2(var("and",m(@2)), $1, $3, m(@1,@3)); }
       | l0expr "or"  l0expr      { $$ = TAPP2(var("or",m(@2)),  $1, $3, m(@1,@3)); }
@@ -653,8 +448,8 @@ l4expr: "if" l4expr "then" l4expr "else" l4expr { $$ = TAPP3(var("if",m(@1)), $2
       | l5expr                                  { $$ = $1; }
 
       /* local variable introduction */
-      | "let" letbindings "in" l0expr { $$ = compileNestedLetMatch(*$2, ExprPtr($4), m(@1,@4))->clone(); }
-      | "let" letbindings ";" "in" l0expr { $$ = compileNestedLetMatch(*$2, ExprPtr($5), m(@1,@5))->clone(); }
+      | "let" letbindings "in" l0expr { $$ = compileNestedLetMatch(yyParseCC, *$2, ExprPtr($4), m(@1,@4))->clone(); }
+      | "let" letbindings ";" "in" l0expr { $$ = compileNestedLetMatch(yyParseCC, *$2, ExprPtr($5), m(@1,@5))->clone(); }
 
       /* pattern matching */
       | "match" l6exprs "with" patternexps { $$ = compileMatch(yyParseCC, *$2, normPatternRules(*$4, m(@1,@4)), m(@1,@4))->clone(); }
@@ -675,8 +470,8 @@ l4expr: "if" l4expr "then" l4expr "else" l4expr { $$ = TAPP3(var("if",m(@1)), $2
       }
 
       /* action sequence */
-      | "do" "{" dobindings "}"                 { $$ = compileNestedLetMatch(*$3, ExprPtr(new Unit(m(@1,@4))), m(@1,@4)); }
-      | "do" "{" dobindings "return" l0expr "}" { $$ = compileNestedLetMatch(*$3, ExprPtr($5), m(@1,@6)); }
+      | "do" "{" dobindings "}"                 { $$ = compileNestedLetMatch(yyParseCC, *$3, ExprPtr(new Unit(m(@1,@4))), m(@1,@4)); }
+      | "do" "{" dobindings "return" l0expr "}" { $$ = compileNestedLetMatch(yyParseCC, *$3, ExprPtr($5), m(@1,@6)); }
 
       /* forced type assignment */
       | l5expr "::" qtype       { $$ = new Assump(ExprPtr($1), QualTypePtr($3), m(@1,@3)); }
@@ -702,8 +497,8 @@ l6expr: l6expr "(" cargs ")"    { $$ = new App(ExprPtr($1), *$3, m(@1, @4)); }
       /* array construction / elimination */
       | "[" l0expr ".." l0expr "]"                        { $$ = new App(var("range", m(@3)), list(ExprPtr($2), ExprPtr($4)), m(@1, @5)); }
       | "[" l0expr ".." "]"                               { $$ = new App(var("iterateS", m(@3)), list(ExprPtr($2), fn(str::strings(".x"), fncall(var("+", m(@3)), list(var(".x", m(@3)), ExprPtr(new Int(1, m(@3)))), m(@3)), m(@3))), m(@1, @4)); }
-      | "[" l0expr "|" pattern "<-" l0expr "]"            { $$ = compileArrayComprehension(ExprPtr($2), PatternPtr($4), ExprPtr($6), m(@1, @7)); }
-      | "[" l0expr "|" pattern "<-" l0expr "," l0expr "]" { $$ = compileArrayComprehension(ExprPtr($2), PatternPtr($4), ExprPtr($6), ExprPtr($8), m(@1, @9)); }
+      | "[" l0expr "|" pattern "<-" l0expr "]"            { $$ = compileArrayComprehension(yyParseCC, ExprPtr($2), PatternPtr($4), ExprPtr($6), ExprPtr(), m(@1, @7)); }
+      | "[" l0expr "|" pattern "<-" l0expr "," l0expr "]" { $$ = compileArrayComprehension(yyParseCC, ExprPtr($2), PatternPtr($4), ExprPtr($6), ExprPtr($8), m(@1, @9)); }
       | "[" cargs "]"                                     { $$ = new MkArray(*$2, m(@1, @3)); }
       | l6expr "[" l0expr "]"                             { $$ = new AIndex(ExprPtr($1), ExprPtr($3), m(@1, @4)); }
       | l6expr "[" l0expr ":" l0expr "]"                  { $$ = new App(var("slice", m(@4)), list(ExprPtr($1), ExprPtr($3), ExprPtr($5)), m(@1, @6)); }
@@ -719,7 +514,7 @@ l6expr: l6expr "(" cargs ")"    { $$ = new App(ExprPtr($1), *$3, m(@1, @4)); }
 
       /* record construction / elimination */
       | "{" recfields "}"   { if ($2->size() > 0) { $$ = new MkRecord(*$2, m(@1, @3)); } else { $$ = new Unit(m(@1, @3)); } }
-      | l6expr recfieldpath { $$ = makeProjSeq($1, *$2, m(@1, @2)); }
+      | l6expr recfieldpath { $$ = makeProjSeq(ExprPtr($1), *$2, m(@1, @2)); }
 
       /* record sections */
       | recfieldpath { $$ = new Fn(str::strings("x"), proj(var("x", m(@1)), *$1, m(@1)), m(@1)); }
@@ -744,7 +539,7 @@ l6expr: l6expr "(" cargs ")"    { $$ = new App(ExprPtr($1), *$3, m(@1, @4)); }
       | "dateTimeV" { $$ = mkDateTimeExpr(*$1, m(@1))->clone(); }
 
       /* take care of unit values, nested terms, and tuples */
-      | "(" cargs ")" { $$ = pickNestedExp($2, m(@1,@3)); }
+      | "(" cargs ")" { $$ = pickNestedExp(*$2, m(@1,@3)); }
 
       /* escapes for infix functions */
       | "(" "++" ")"  { $$ = new Var("append", m(@2)); }
@@ -822,12 +617,12 @@ refutablep: "boolV"                    { $$ = new MatchLiteral(PrimitivePtr(new
           | "|" id "|"                 { $$ = new MatchVariant(*$2, PatternPtr(new MatchLiteral(PrimitivePtr(new Unit(m(@2))), m(@2))), m(@1,@3)); }
           | "|" id "=" pattern "|"     { $$ = new MatchVariant(*$2, PatternPtr($4), m(@1,@5)); }
           | "|" "intV" "=" pattern "|" { $$ = new MatchVariant(".f" + str::from($2), PatternPtr($4), m(@1,@5)); }
-          | "(" patternseq ")"         { $$ = pickNestedPat($2, m(@1,@3)); }
+          | "(" patternseq ")"         { $$ = pickNestedPat(*$2, m(@1,@3)); }
           | "{" recpatfields "}"       { $$ = new MatchRecord(*$2, m(@1,@3)); }
           | id                         { $$ = patVarCtorFn(*$1, m(@1)); }
 
 irrefutablep: id                   { $$ = new MatchAny(*$1, m(@1)); }
-            | "(" patternseq ")"   { $$ = pickNestedPat($2, m(@1,@3)); }
+            | "(" patternseq ")"   { $$ = pickNestedPat(*$2, m(@1,@3)); }
             | "{" recpatfields "}" { $$ = new MatchRecord(*$2, m(@1,@3)); }
 
 pattern: refutablep { $$ = $1; }
@@ -921,7 +716,7 @@ l0mtype: l0mtargl "->" l1mtype { $$ = autorelease(new MonoTypePtr(Func::make(tup
        | mtuplist              { $$ = autorelease(new MonoTypePtr(makeTupleType(*$1))); }
        | msumlist              { $$ = autorelease(new MonoTypePtr(makeSumType(*$1))); }
 
-l1mtype: id                                { $$ = autorelease(new MonoTypePtr(monoTypeByName(*$1))); }
+l1mtype: id                                { $$ = autorelease(new MonoTypePtr(monoTypeByName(yyParseCC, *$1))); }
        | "<" cppid ">"                     { $$ = autorelease(new MonoTypePtr(OpaquePtr::make(str::replace<char>(*$2, ".", "::"), 0, false))); }
        | "[" "]"                           { $$ = autorelease(new MonoTypePtr(Prim::make("[]"))); }
        | "[" ltmtype "]"                   { try { $$ = autorelease(new MonoTypePtr(Array::make(yyParseCC->replaceTypeAliases(accumTApp(*$2))))); } catch (std::exception& ex) { throw annotated_error(m(@2), ex.what()); } }